@@ -39,6 +39,7 @@
 #include <gtk/gtk.h>
 
 #include "gs-theme-window.h"
+#include "gste-gamma.h"
 
 #ifndef trunc
 #define trunc(x) (((x) > 0.0) ? floor((x)) : -floor(-(x)))
@@ -63,6 +64,17 @@
 #define FLOATER_DEFAULT_COUNT (5)
 #endif
 
+/* the image is rasterized once at the largest size and at every half
+ * of it down to the smallest, and each floater is scaled down from
+ * the closest larger one
+ */
+#define ATLAS_N_LEVELS (4)
+
+/* transparent pixels between the levels, so scaling one does not
+ * pick up its neighbour
+ */
+#define ATLAS_PADDING (2)
+
 #ifndef SMALL_ANGLE
 #define SMALL_ANGLE (0.025 * G_PI)
 #endif
@@ -79,7 +91,7 @@ typedef struct _Point Point;
 typedef struct _Path Path;
 typedef struct _Rectangle Rectangle;
 typedef struct _ScreenSaverFloater ScreenSaverFloater;
-typedef struct _CachedSource CachedSource;
+typedef struct _SpriteAtlas SpriteAtlas;
 typedef struct _ScreenSaver ScreenSaver;
 
 struct _Point
@@ -106,10 +118,13 @@ struct _Path
 	gdouble duration;
 };
 
-struct _CachedSource
+struct _SpriteAtlas
 {
-	cairo_pattern_t *pattern;
-	gint width, height;
+	/* all the levels side by side, largest first */
+	cairo_surface_t *surface;
+
+	GdkRectangle levels[ATLAS_N_LEVELS];
+	gint n_levels;
 };
 
 struct _Rectangle
@@ -141,10 +156,18 @@ struct _ScreenSaver
 {
 	GtkWidget  *drawing_area;
 	Rectangle canvas_rectangle;
-	GHashTable *cached_sources;
 
 	char *filename;
 
+	/* rasterized by atlas_thread at startup; floaters are not drawn
+	 * until it is done
+	 */
+	GThread *atlas_thread;
+	SpriteAtlas *atlas;
+	/* the atlas copied once to where it is drawn */
+	cairo_surface_t *atlas_source;
+	guint atlas_failed : 1;
+
 	gdouble first_update_time;
 
 	gdouble last_calculated_stats_time,
@@ -216,10 +239,9 @@ static gboolean screen_saver_floater_do_draw (ScreenSaver        *screen_saver,
         ScreenSaverFloater *floater,
         cairo_t            *context);
 
-static CachedSource *cached_source_new (cairo_pattern_t *pattern,
-                                        gint             width,
-                                        gint             height);
-static void cached_source_free (CachedSource *source);
+static SpriteAtlas *sprite_atlas_new_from_file (const gchar  *filename,
+        GError      **error);
+static void sprite_atlas_free (SpriteAtlas *atlas);
 
 static ScreenSaver *screen_saver_new (GtkWidget       *drawing_area,
                                       const gchar     *filename,
@@ -243,32 +265,90 @@ static void screen_saver_on_size_allocate (ScreenSaver   *screen_saver,
 static void screen_saver_on_draw (ScreenSaver    *screen_saver,
         cairo_t *context);
 static gboolean do_print_screen_saver_stats (ScreenSaver *screen_saver);
-static GdkPixbuf *gamma_correct (const GdkPixbuf *input_pixbuf);
 
-static CachedSource*
-cached_source_new (cairo_pattern_t *pattern,
-                   gint              width,
-                   gint             height)
+static SpriteAtlas *
+sprite_atlas_new_from_file (const gchar  *filename,
+                            GError      **error)
 {
-	CachedSource *source;
+	SpriteAtlas *atlas;
+	GdkPixbuf *pixbufs[ATLAS_N_LEVELS];
+	cairo_t *context;
+	gint width, height;
+	gint n_levels;
+	gint i, x;
+
+	width = 0;
+	height = 0;
+
+	for (n_levels = 0; n_levels < ATLAS_N_LEVELS; n_levels++)
+	{
+		gint size;
+
+		size = (gint) FLOATER_MAX_SIZE >> n_levels;
+		if (size < FLOATER_MIN_SIZE)
+			break;
+
+		/* at every size, so that vector images stay sharp */
+		pixbufs[n_levels] = gdk_pixbuf_new_from_file_at_size (filename, size, -1,
+		                    error);
+		if (pixbufs[n_levels] == NULL)
+		{
+			for (i = 0; i < n_levels; i++)
+				g_object_unref (pixbufs[i]);
+			return NULL;
+		}
+
+		/* in place, before gdk_cairo_set_source_pixbuf() premultiplies */
+		if (gdk_pixbuf_get_has_alpha (pixbufs[n_levels]))
+			gste_gamma_correct_alpha (gdk_pixbuf_get_pixels (pixbufs[n_levels]),
+			                          gdk_pixbuf_get_width (pixbufs[n_levels]),
+			                          gdk_pixbuf_get_height (pixbufs[n_levels]),
+			                          gdk_pixbuf_get_rowstride (pixbufs[n_levels]),
+			                          GAMMA);
+
+		width += gdk_pixbuf_get_width (pixbufs[n_levels]) + ATLAS_PADDING;
+		height = MAX (height, gdk_pixbuf_get_height (pixbufs[n_levels]));
+	}
 
-	source = g_new (CachedSource, 1);
-	source->pattern = cairo_pattern_reference (pattern);
-	source->width = width;
-	source->height = height;
+	atlas = g_new0 (SpriteAtlas, 1);
+	atlas->n_levels = n_levels;
+	atlas->surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+	                 width, height);
 
-	return source;
+	context = cairo_create (atlas->surface);
+	cairo_set_operator (context, CAIRO_OPERATOR_SOURCE);
+
+	for (i = 0, x = 0; i < n_levels; i++)
+	{
+		GdkRectangle *level = &atlas->levels[i];
+
+		level->x = x;
+		level->y = 0;
+		level->width = gdk_pixbuf_get_width (pixbufs[i]);
+		level->height = gdk_pixbuf_get_height (pixbufs[i]);
+
+		gdk_cairo_set_source_pixbuf (context, pixbufs[i], level->x, level->y);
+		cairo_rectangle (context, level->x, level->y, level->width, level->height);
+		cairo_fill (context);
+
+		x += level->width + ATLAS_PADDING;
+		g_object_unref (pixbufs[i]);
+	}
+
+	cairo_destroy (context);
+
+	return atlas;
 }
 
 static void
-cached_source_free (CachedSource *source)
+sprite_atlas_free (SpriteAtlas *atlas)
 {
-	if (source == NULL)
+	if (atlas == NULL)
 		return;
 
-	cairo_pattern_destroy (source->pattern);
+	cairo_surface_destroy (atlas->surface);
 
-	g_free (source);
+	g_free (atlas);
 }
 
 static Path *
@@ -615,87 +695,58 @@ screen_saver_floater_update_state (ScreenSaver        *screen_saver,
 	}
 }
 
-static GdkPixbuf *
-gamma_correct (const GdkPixbuf *input_pixbuf)
-{
-	gint x, y, width, height, rowstride;
-	GdkPixbuf *output_pixbuf;
-	guchar *pixels;
-
-	output_pixbuf = gdk_pixbuf_copy (input_pixbuf);
-	pixels = gdk_pixbuf_get_pixels (output_pixbuf);
-
-	width = gdk_pixbuf_get_width (output_pixbuf);
-	height = gdk_pixbuf_get_height (output_pixbuf);
-	rowstride = gdk_pixbuf_get_rowstride (output_pixbuf);
-
-	for (y = 0; y < height; y++)
-		for (x = 0; x < width; x++)
-		{
-			guchar *alpha_channel;
-			guchar opacity;
-
-			alpha_channel = pixels + y * (rowstride / 4) + x + 3;
-			opacity = (guchar) (255 * pow ((*alpha_channel / 255.0), 1.0 / GAMMA));
-
-			*alpha_channel = opacity;
-		}
-
-	return output_pixbuf;
-}
-
 static gboolean
 screen_saver_floater_do_draw (ScreenSaver        *screen_saver,
                               ScreenSaverFloater *floater,
                               cairo_t            *context)
 {
 	gint size;
-	CachedSource *source;
+	gint i;
+	GdkRectangle *level;
+	gdouble scale;
+	gdouble width, height;
+
+	if (screen_saver->atlas == NULL)
+		return !screen_saver->atlas_failed;
 
 	size = CLAMP ((int) (FLOATER_MAX_SIZE * floater->scale),
 	              FLOATER_MIN_SIZE, FLOATER_MAX_SIZE);
 
-	source = g_hash_table_lookup (screen_saver->cached_sources, GINT_TO_POINTER (size));
-
-	if (source == NULL)
+	if (screen_saver->atlas_source == NULL)
 	{
-		GdkPixbuf *pixbuf;
-		GError *error;
-
-		pixbuf = NULL;
-		error = NULL;
-
-		pixbuf = gdk_pixbuf_new_from_file_at_size (screen_saver->filename, size, -1,
-		         &error);
-		if (pixbuf == NULL)
-		{
-			g_assert (error != NULL);
-			g_printerr ("%s", _(error->message));
-			g_error_free (error);
-			return FALSE;
-		}
-
-		if (gdk_pixbuf_get_has_alpha (pixbuf))
-			gamma_correct (pixbuf);
+		cairo_t *atlas_context;
+
+		/* the only upload of the image */
+		screen_saver->atlas_source =
+		    cairo_surface_create_similar (cairo_get_target (context),
+		                                  CAIRO_CONTENT_COLOR_ALPHA,
+		                                  cairo_image_surface_get_width (screen_saver->atlas->surface),
+		                                  cairo_image_surface_get_height (screen_saver->atlas->surface));
+		atlas_context = cairo_create (screen_saver->atlas_source);
+		cairo_set_operator (atlas_context, CAIRO_OPERATOR_SOURCE);
+		cairo_set_source_surface (atlas_context, screen_saver->atlas->surface, 0.0, 0.0);
+		cairo_paint (atlas_context);
+		cairo_destroy (atlas_context);
+	}
 
-		gdk_cairo_set_source_pixbuf (context, pixbuf, 0.0, 0.0);
+	/* the smallest level that is not smaller than the floater */
+	for (i = screen_saver->atlas->n_levels - 1; i > 0; i--)
+		if (screen_saver->atlas->levels[i].width >= size)
+			break;
 
-		source = cached_source_new (cairo_get_source (context),
-		                            gdk_pixbuf_get_width (pixbuf),
-		                            gdk_pixbuf_get_height (pixbuf));
-		g_object_unref (pixbuf);
-		g_hash_table_insert (screen_saver->cached_sources, GINT_TO_POINTER (size),
-		                     source);
-	}
+	level = &screen_saver->atlas->levels[i];
+	scale = (gdouble) size / level->width;
+	width = size;
+	height = level->height * scale;
 
 	cairo_save (context);
 
 	if (screen_saver->should_do_rotations && (fabs (floater->angle) > G_MINDOUBLE))
 	{
-		floater->bounds.width = G_SQRT2 * source->width + 2;
-		floater->bounds.height = G_SQRT2 * source->height + 2;
-		floater->bounds.x = (int) (floater->position.x - .5 * G_SQRT2 * source->width) - 1;
-		floater->bounds.y = (int) (floater->position.y - .5 * G_SQRT2 * source->height) - 1;
+		floater->bounds.width = G_SQRT2 * width + 2;
+		floater->bounds.height = G_SQRT2 * height + 2;
+		floater->bounds.x = (int) (floater->position.x - .5 * G_SQRT2 * width) - 1;
+		floater->bounds.y = (int) (floater->position.y - .5 * G_SQRT2 * height) - 1;
 
 		cairo_translate (context,
 		                 trunc (floater->position.x),
@@ -707,24 +758,29 @@ screen_saver_floater_do_draw (ScreenSaver        *screen_saver,
 	}
 	else
 	{
-		floater->bounds.width = source->width + 2;
-		floater->bounds.height = source->height + 2;
-		floater->bounds.x = (int) (floater->position.x - .5 * source->width) - 1;
-		floater->bounds.y = (int) (floater->position.y - .5 * source->height) - 1;
+		floater->bounds.width = width + 2;
+		floater->bounds.height = height + 2;
+		floater->bounds.x = (int) (floater->position.x - .5 * width) - 1;
+		floater->bounds.y = (int) (floater->position.y - .5 * height) - 1;
 	}
 
 	cairo_translate (context,
-	                 trunc (floater->position.x - .5 * source->width),
-	                 trunc (floater->position.y - .5 * source->height));
-
-	cairo_set_source (context, source->pattern);
+	                 trunc (floater->position.x - .5 * width),
+	                 trunc (floater->position.y - .5 * height));
 
 	cairo_rectangle (context,
-	                 trunc (.5 * (source->width - floater->bounds.width)),
-	                 trunc (.5 * (source->height - floater->bounds.height)),
+	                 trunc (.5 * (width - floater->bounds.width)),
+	                 trunc (.5 * (height - floater->bounds.height)),
 	                 floater->bounds.width, floater->bounds.height);
+	cairo_clip (context);
 
+	/* intermediate sizes are scaled down from the level */
+	cairo_scale (context, scale, scale);
+	cairo_rectangle (context, 0, 0, level->width, level->height);
 	cairo_clip (context);
+
+	cairo_set_source_surface (context, screen_saver->atlas_source,
+	                          -level->x, -level->y);
 	cairo_paint_with_alpha (context, floater->opacity);
 	cairo_restore (context);
 
@@ -791,6 +847,41 @@ screen_saver_floater_do_draw (ScreenSaver        *screen_saver,
 	return TRUE;
 }
 
+static gboolean
+screen_saver_on_atlas_loaded (ScreenSaver *screen_saver)
+{
+	screen_saver->atlas = g_thread_join (screen_saver->atlas_thread);
+	screen_saver->atlas_thread = NULL;
+
+	if (screen_saver->atlas == NULL)
+		screen_saver->atlas_failed = TRUE;
+	else
+		gtk_widget_queue_draw (screen_saver->drawing_area);
+
+	return FALSE;
+}
+
+static gpointer
+screen_saver_load_atlas (ScreenSaver *screen_saver)
+{
+	SpriteAtlas *atlas;
+	GError *error;
+
+	error = NULL;
+	atlas = sprite_atlas_new_from_file (screen_saver->filename, &error);
+	if (atlas == NULL)
+	{
+		g_assert (error != NULL);
+		g_printerr ("%s", _(error->message));
+		g_error_free (error);
+	}
+
+	/* joined there */
+	g_idle_add ((GSourceFunc) screen_saver_on_atlas_loaded, screen_saver);
+
+	return atlas;
+}
+
 static ScreenSaver *
 screen_saver_new (GtkWidget       *drawing_area,
                   const gchar     *filename,
@@ -803,9 +894,16 @@ screen_saver_new (GtkWidget       *drawing_area,
 	screen_saver = g_new (ScreenSaver, 1);
 	screen_saver->filename = g_strdup (filename);
 	screen_saver->drawing_area = drawing_area;
-	screen_saver->cached_sources =
-	    g_hash_table_new_full (NULL, NULL, NULL,
-	                           (GDestroyNotify) cached_source_free);
+	screen_saver->atlas = NULL;
+	screen_saver->atlas_source = NULL;
+	screen_saver->atlas_failed = FALSE;
+
+	/* rasterizing the image can take a while, it is done once up
+	 * front rather than whenever a floater reaches a new size
+	 */
+	screen_saver->atlas_thread = g_thread_new ("floaters-atlas",
+	                             (GThreadFunc) screen_saver_load_atlas,
+	                             screen_saver);
 
 	g_signal_connect_swapped (drawing_area, "size-allocate",
 	                          G_CALLBACK (screen_saver_on_size_allocate),
@@ -847,9 +945,17 @@ screen_saver_free (ScreenSaver *screen_saver)
 	if (screen_saver == NULL)
 		return;
 
-	g_free (screen_saver->filename);
+	if (screen_saver->atlas_thread != NULL)
+	{
+		sprite_atlas_free (g_thread_join (screen_saver->atlas_thread));
+		g_idle_remove_by_data (screen_saver);
+	}
 
-	g_hash_table_destroy (screen_saver->cached_sources);
+	sprite_atlas_free (screen_saver->atlas);
+	if (screen_saver->atlas_source != NULL)
+		cairo_surface_destroy (screen_saver->atlas_source);
+
+	g_free (screen_saver->filename);
 
 	if (screen_saver->state_update_timeout_id != 0) {
 		g_source_remove (screen_saver->state_update_timeout_id);
@@ -913,9 +1019,8 @@ screen_saver_get_frames_per_second (ScreenSaver *screen_saver)
 static gdouble
 screen_saver_get_image_cache_usage (ScreenSaver *screen_saver)
 {
-	static const gdouble cache_capacity = (FLOATER_MAX_SIZE - FLOATER_MIN_SIZE + 1);
-
-	return g_hash_table_size (screen_saver->cached_sources) / cache_capacity;
+	/* every size is in the atlas once it is there */
+	return screen_saver->atlas != NULL ? 1.0 : 0.0;
 }
 
 static void
@@ -24,11 +24,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <signal.h>
 #include <unistd.h>
 
 #include <glib.h>
+#include <glib-unix.h>
 #include <gtk/gtk.h>
 
+#include "gs-profile-trace.h"
 #include "gs-theme-engine.h"
 #include "gs-theme-engine-marshal.h"
 
@@ -36,40 +39,97 @@ static void     gs_theme_engine_finalize   (GObject            *object);
 
 struct GSThemeEnginePrivate
 {
-	gpointer reserved;
+	/* ticks were asked for, they only run while mapped */
+	gboolean ticking;
+	guint    tick_id;
 };
 
 static GObjectClass *parent_class = NULL;
 
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (GSThemeEngine, gs_theme_engine, GTK_TYPE_DRAWING_AREA)
 
+/* A lean version of the ring buffer in src/gs-debug.c, dumped through
+ * the same trace writer.  The savers only mark from the main thread, so
+ * a single ring is enough.
+ */
+#define PROFILE_RING_SIZE 4096
+
+typedef struct
+{
+	gint64                          time;
+	const GSThemeEngineProfileSite *site;
+	gint64                          value;
+} GSThemeEngineProfileRecord;
+
+gboolean                          _gs_theme_engine_profile_enabled = FALSE;
+static GSThemeEngineProfileRecord *profile_ring = NULL;
+static guint                      profile_head = 0;
+
 void
-_gs_theme_engine_profile_log (const char *func,
-                              const char *note,
-                              const char *format,
-                              ...)
+_gs_theme_engine_profile_record (const GSThemeEngineProfileSite *site,
+                                 gint64                          value)
 {
-	va_list args;
-	char   *str;
-	char   *formatted;
+	GSThemeEngineProfileRecord *record;
+
+	record = &profile_ring [profile_head++ % PROFILE_RING_SIZE];
+	record->time = g_get_monotonic_time ();
+	record->site = site;
+	record->value = value;
+}
+
+/* Writes the marks in the same trace format as the daemon */
+static gboolean
+profile_dump_cb (gpointer data)
+{
+	GString *str;
+	char    *contents;
+	char    *path;
+	GError  *error;
+	guint    first;
+	guint    i;
+
+	str = gs_profile_trace_new ();
 
-	va_start (args, format);
-	formatted = g_strdup_vprintf (format, args);
-	va_end (args);
+	first = profile_head - MIN (profile_head, PROFILE_RING_SIZE);
 
-	if (func != NULL)
+	for (i = first; i != profile_head; i++)
 	{
-		str = g_strdup_printf ("MARK: %s %s: %s %s", g_get_prgname(), func, note ? note : "", formatted);
+		GSThemeEngineProfileRecord *record;
+
+		record = &profile_ring [i % PROFILE_RING_SIZE];
+		gs_profile_trace_append (str, 1, record->time,
+		                         record->site->func,
+		                         record->site->note,
+		                         record->site->label,
+		                         record->value);
 	}
-	else
+
+	contents = gs_profile_trace_finish (str);
+
+	error = NULL;
+	if (! gs_profile_trace_write (contents, &path, &error))
 	{
-		str = g_strdup_printf ("MARK: %s: %s %s", g_get_prgname(), note ? note : "", formatted);
+		g_warning ("Unable to write profile: %s", error->message);
+		g_error_free (error);
 	}
 
-	g_free (formatted);
+	g_free (contents);
+	g_free (path);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+profile_init (void)
+{
+	if (g_getenv ("MATE_SCREENSAVER_PROFILE") == NULL)
+	{
+		return;
+	}
 
-	access (str, F_OK);
-	g_free (str);
+	profile_ring = g_new0 (GSThemeEngineProfileRecord, PROFILE_RING_SIZE);
+	_gs_theme_engine_profile_enabled = TRUE;
+	g_unix_signal_add (SIGUSR1, profile_dump_cb, NULL);
 }
 
 static void
@@ -115,6 +175,75 @@ gs_theme_engine_real_draw (GtkWidget *widget,
 	return FALSE;
 }
 
+static gboolean
+tick_cb (GtkWidget     *widget,
+         GdkFrameClock *frame_clock,
+         gpointer       user_data)
+{
+	GSThemeEngine *engine = GS_THEME_ENGINE (widget);
+
+	if (GS_THEME_ENGINE_GET_CLASS (engine)->tick != NULL)
+	{
+		GS_THEME_ENGINE_GET_CLASS (engine)->tick (engine,
+		        gdk_frame_clock_get_frame_time (frame_clock));
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+add_tick_callback (GSThemeEngine *engine)
+{
+	if (engine->priv->tick_id == 0)
+	{
+		engine->priv->tick_id = gtk_widget_add_tick_callback (GTK_WIDGET (engine),
+		                                                      tick_cb,
+		                                                      NULL,
+		                                                      NULL);
+	}
+}
+
+static void
+remove_tick_callback (GSThemeEngine *engine)
+{
+	if (engine->priv->tick_id != 0)
+	{
+		gtk_widget_remove_tick_callback (GTK_WIDGET (engine),
+		                                 engine->priv->tick_id);
+		engine->priv->tick_id = 0;
+	}
+}
+
+static void
+gs_theme_engine_real_map (GtkWidget *widget)
+{
+	GSThemeEngine *engine = GS_THEME_ENGINE (widget);
+
+	if (GTK_WIDGET_CLASS (parent_class)->map)
+	{
+		GTK_WIDGET_CLASS (parent_class)->map (widget);
+	}
+
+	if (engine->priv->ticking)
+	{
+		add_tick_callback (engine);
+	}
+}
+
+static void
+gs_theme_engine_real_unmap (GtkWidget *widget)
+{
+	GSThemeEngine *engine = GS_THEME_ENGINE (widget);
+
+	/* nothing to animate while nothing can be seen */
+	remove_tick_callback (engine);
+
+	if (GTK_WIDGET_CLASS (parent_class)->unmap)
+	{
+		GTK_WIDGET_CLASS (parent_class)->unmap (widget);
+	}
+}
+
 static void
 gs_theme_engine_class_init (GSThemeEngineClass *klass)
 {
@@ -128,6 +257,10 @@ gs_theme_engine_class_init (GSThemeEngineClass *klass)
 	object_class->set_property = gs_theme_engine_set_property;
 
 	widget_class->draw = gs_theme_engine_real_draw;
+	widget_class->map = gs_theme_engine_real_map;
+	widget_class->unmap = gs_theme_engine_real_unmap;
+
+	profile_init ();
 }
 
 static void
@@ -148,6 +281,8 @@ gs_theme_engine_finalize (GObject *object)
 
 	g_return_if_fail (engine->priv != NULL);
 
+	remove_tick_callback (engine);
+
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -186,3 +321,37 @@ gs_theme_engine_get_window (GSThemeEngine *engine)
 
 	return gtk_widget_get_window (GTK_WIDGET (engine));
 }
+
+/* Makes the tick class function run once per frame, paced by the
+   frame clock, until gs_theme_engine_stop_ticks() is called. Ticks
+   are held back while the widget is not mapped. */
+void
+gs_theme_engine_start_ticks (GSThemeEngine *engine)
+{
+	g_return_if_fail (GS_IS_THEME_ENGINE (engine));
+
+	engine->priv->ticking = TRUE;
+
+	if (gtk_widget_get_mapped (GTK_WIDGET (engine)))
+	{
+		add_tick_callback (engine);
+	}
+}
+
+void
+gs_theme_engine_stop_ticks (GSThemeEngine *engine)
+{
+	g_return_if_fail (GS_IS_THEME_ENGINE (engine));
+
+	engine->priv->ticking = FALSE;
+
+	remove_tick_callback (engine);
+}
+
+gboolean
+gs_theme_engine_get_ticking (GSThemeEngine *engine)
+{
+	g_return_val_if_fail (GS_IS_THEME_ENGINE (engine), FALSE);
+
+	return engine->priv->ticking;
+}
@@ -48,8 +48,13 @@ typedef struct
 {
 	GtkDrawingAreaClass parent_class;
 
+	/* called once per frame of the display while ticks are
+	 * started and the widget is mapped; frame_time is the
+	 * monotonic time the frame will be shown at, in microseconds */
+	void (* tick) (GSThemeEngine *engine,
+	               gint64         frame_time);
+
 	/* for signals later if needed */
-	gpointer reserved_1;
 	gpointer reserved_2;
 	gpointer reserved_3;
 	gpointer reserved_4;
@@ -62,27 +67,40 @@ void            gs_theme_engine_get_window_size (GSThemeEngine *engine,
         int           *height);
 GdkWindow      *gs_theme_engine_get_window      (GSThemeEngine *engine);
 
+void            gs_theme_engine_start_ticks     (GSThemeEngine *engine);
+void            gs_theme_engine_stop_ticks      (GSThemeEngine *engine);
+gboolean        gs_theme_engine_get_ticking     (GSThemeEngine *engine);
+
+typedef struct
+{
+	const char *func;
+	const char *note;
+	const char *label;
+} GSThemeEngineProfileSite;
+
+/* set when MATE_SCREENSAVER_PROFILE is in the environment */
+extern gboolean _gs_theme_engine_profile_enabled;
+
 #define ENABLE_PROFILING 1
 #ifdef ENABLE_PROFILING
-#ifdef G_HAVE_ISO_VARARGS
-#define gs_theme_engine_profile_start(...) _gs_theme_engine_profile_log (G_STRFUNC, "start", __VA_ARGS__)
-#define gs_theme_engine_profile_end(...)   _gs_theme_engine_profile_log (G_STRFUNC, "end", __VA_ARGS__)
-#define gs_theme_engine_profile_msg(...)   _gs_theme_engine_profile_log (NULL, NULL, __VA_ARGS__)
-#elif defined(G_HAVE_GNUC_VARARGS)
-#define gs_theme_engine_profile_start(format...) _gs_theme_engine_profile_log (G_STRFUNC, "start", format)
-#define gs_theme_engine_profile_end(format...)   _gs_theme_engine_profile_log (G_STRFUNC, "end", format)
-#define gs_theme_engine_profile_msg(format...)   _gs_theme_engine_profile_log (NULL, NULL, format)
-#endif
+#define _gs_theme_engine_profile_mark(note, label, value) G_STMT_START {                 \
+		static const GSThemeEngineProfileSite _gs_profile_site = { G_STRFUNC, note, label }; \
+		if (G_UNLIKELY (_gs_theme_engine_profile_enabled))                               \
+			_gs_theme_engine_profile_record (&_gs_profile_site, (value));            \
+	} G_STMT_END
+#define gs_theme_engine_profile_start(label)        _gs_theme_engine_profile_mark ("start", label, 0)
+#define gs_theme_engine_profile_end(label)          _gs_theme_engine_profile_mark ("end", label, 0)
+#define gs_theme_engine_profile_msg(label)          _gs_theme_engine_profile_mark (NULL, label, 0)
+#define gs_theme_engine_profile_value(label, value) _gs_theme_engine_profile_mark ("value", label, value)
 #else
-#define gs_theme_engine_profile_start(...)
-#define gs_theme_engine_profile_end(...)
-#define gs_theme_engine_profile_msg(...)
+#define gs_theme_engine_profile_start(label)
+#define gs_theme_engine_profile_end(label)
+#define gs_theme_engine_profile_msg(label)
+#define gs_theme_engine_profile_value(label, value)
 #endif
 
-void            _gs_theme_engine_profile_log    (const char *func,
-        const char *note,
-        const char *format,
-        ...) G_GNUC_PRINTF (3, 4);
+void            _gs_theme_engine_profile_record (const GSThemeEngineProfileSite *site,
+        gint64                          value);
 
 G_END_DECLS
 
@@ -0,0 +1,60 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <math.h>
+
+#include <glib.h>
+
+#include "gste-gamma.h"
+
+void
+gste_gamma_correct_alpha (guchar *pixels,
+                          int     width,
+                          int     height,
+                          int     rowstride,
+                          gdouble gamma)
+{
+	guchar table[256];
+	int    x, y;
+	int    i;
+
+	g_return_if_fail (pixels != NULL || width == 0 || height == 0);
+	g_return_if_fail (rowstride >= width * 4);
+	g_return_if_fail (gamma > 0.0);
+
+	/* one pow() per possible value rather than per pixel */
+	for (i = 0; i < 256; i++)
+	{
+		table[i] = (guchar) (255 * pow (i / 255.0, 1.0 / gamma));
+	}
+
+	for (y = 0; y < height; y++)
+	{
+		guchar *row = pixels + (gsize) y * rowstride;
+
+		for (x = 0; x < width; x++)
+		{
+			row[4 * x + 3] = table[row[4 * x + 3]];
+		}
+	}
+}
@@ -0,0 +1,40 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __GSTE_GAMMA_H
+#define __GSTE_GAMMA_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Raises the alpha of unpremultiplied RGBA pixels, such as the data
+   of a GdkPixbuf with alpha, to the power 1 / gamma. The color
+   channels are left alone, so premultiplying afterwards gives the
+   corrected coverage. */
+void gste_gamma_correct_alpha (guchar *pixels,
+                               int     width,
+                               int     height,
+                               int     rowstride,
+                               gdouble gamma);
+
+G_END_DECLS
+
+#endif /* __GSTE_GAMMA_H */
@@ -0,0 +1,402 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <sys/types.h>
+#include <utime.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <cairo.h>
+
+#include "gste-image-cache.h"
+
+/* Entries are raw premultiplied cairo image data behind a small
+   header, so a hit is a mmap() with no decoding or conversion. The
+   file name is a hash of the source path, its mtime and size, and
+   the size it was scaled for; the mtime of the entry itself is used
+   as the LRU clock. */
+
+#define CACHE_MAGIC     "GSTEIMG2"
+#define CACHE_SUFFIX    ".img"
+
+/* how much is left after an eviction, in percent of the maximum */
+#define CACHE_TRIM_TARGET 75
+
+typedef struct
+{
+	char    magic[8];
+	guint32 format;
+	guint32 width;
+	guint32 height;
+	guint32 stride;
+	guint64 length;
+} CacheHeader;
+
+static const cairo_user_data_key_t mapping_key;
+
+typedef struct
+{
+	char   *path;
+	gint64  mtime;
+	goffset size;
+} CacheEntry;
+
+struct GSTEImageCache
+{
+	char   *dir;
+
+	/* guards the fields below */
+	GMutex  lock;
+	goffset max_size;
+	/* bytes on disk, -1 until the directory has been scanned */
+	goffset total_size;
+};
+
+GSTEImageCache *
+gste_image_cache_new (const char *name,
+                      goffset     max_size)
+{
+	GSTEImageCache *cache;
+
+	g_return_val_if_fail (name != NULL, NULL);
+
+	cache = g_new0 (GSTEImageCache, 1);
+
+	cache->dir = g_build_filename (g_get_user_cache_dir (),
+	                               "mate-screensaver",
+	                               name,
+	                               NULL);
+	g_mutex_init (&cache->lock);
+	cache->max_size = max_size;
+	cache->total_size = -1;
+
+	return cache;
+}
+
+void
+gste_image_cache_free (GSTEImageCache *cache)
+{
+	if (cache == NULL)
+	{
+		return;
+	}
+
+	g_mutex_clear (&cache->lock);
+	g_free (cache->dir);
+	g_free (cache);
+}
+
+void
+gste_image_cache_set_max_size (GSTEImageCache *cache,
+                               goffset         max_size)
+{
+	g_return_if_fail (cache != NULL);
+
+	g_mutex_lock (&cache->lock);
+	cache->max_size = max_size;
+	g_mutex_unlock (&cache->lock);
+}
+
+static gboolean
+cache_is_enabled (GSTEImageCache *cache)
+{
+	gboolean enabled;
+
+	g_mutex_lock (&cache->lock);
+	enabled = cache->max_size > 0;
+	g_mutex_unlock (&cache->lock);
+
+	return enabled;
+}
+
+char *
+gste_image_cache_get_key (GSTEImageCache *cache,
+                          const char     *filename,
+                          int             width,
+                          int             height,
+                          gboolean        no_stretch_hint,
+                          gboolean        cover)
+{
+	GStatBuf st;
+	char    *str;
+	char    *digest;
+	char    *key;
+
+	g_return_val_if_fail (cache != NULL, NULL);
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	if (! cache_is_enabled (cache))
+	{
+		return NULL;
+	}
+
+	if (g_stat (filename, &st) != 0)
+	{
+		return NULL;
+	}
+
+	str = g_strdup_printf ("%s\n%" G_GINT64_FORMAT "\n%" G_GINT64_FORMAT "\n%dx%d\n%d\n%d",
+	                       filename,
+	                       (gint64) st.st_mtime,
+	                       (gint64) st.st_size,
+	                       width,
+	                       height,
+	                       no_stretch_hint ? 1 : 0,
+	                       cover ? 1 : 0);
+	digest = g_compute_checksum_for_string (G_CHECKSUM_SHA1, str, -1);
+	key = g_strconcat (digest, CACHE_SUFFIX, NULL);
+
+	g_free (digest);
+	g_free (str);
+
+	return key;
+}
+
+cairo_surface_t *
+gste_image_cache_lookup (GSTEImageCache *cache,
+                         const char     *key)
+{
+	GMappedFile     *file;
+	CacheHeader      header;
+	cairo_surface_t *image;
+	char            *path;
+	gsize            length;
+
+	g_return_val_if_fail (cache != NULL, NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+
+	path = g_build_filename (cache->dir, key, NULL);
+
+	file = g_mapped_file_new (path, FALSE, NULL);
+	if (file == NULL)
+	{
+		g_free (path);
+		return NULL;
+	}
+
+	image = NULL;
+	length = g_mapped_file_get_length (file);
+
+	if (length < sizeof (header))
+	{
+		goto out;
+	}
+
+	memcpy (&header, g_mapped_file_get_contents (file), sizeof (header));
+
+	if (memcmp (header.magic, CACHE_MAGIC, sizeof (header.magic)) != 0
+	        || (header.format != CAIRO_FORMAT_ARGB32 && header.format != CAIRO_FORMAT_RGB24)
+	        || header.width == 0
+	        || header.width > G_MAXINT16
+	        || header.height == 0
+	        || header.height > G_MAXINT16
+	        || header.stride != (guint32) cairo_format_stride_for_width (header.format, header.width)
+	        || header.length != length - sizeof (header)
+	        || header.length != (guint64) header.stride * header.height)
+	{
+		goto out;
+	}
+
+	/* the surface is only ever read, it can use the mapping */
+	image = cairo_image_surface_create_for_data ((guchar *) g_mapped_file_get_contents (file) + sizeof (header),
+	                                             header.format,
+	                                             header.width,
+	                                             header.height,
+	                                             header.stride);
+	if (cairo_surface_status (image) != CAIRO_STATUS_SUCCESS)
+	{
+		cairo_surface_destroy (image);
+		image = NULL;
+		goto out;
+	}
+
+	cairo_surface_set_user_data (image, &mapping_key,
+	                             g_mapped_file_ref (file),
+	                             (cairo_destroy_func_t) g_mapped_file_unref);
+
+	/* mark as recently used */
+	g_utime (path, NULL);
+
+out:
+	g_mapped_file_unref (file);
+	g_free (path);
+
+	return image;
+}
+
+static int
+cache_entry_compare_mtime (gconstpointer a,
+                           gconstpointer b)
+{
+	const CacheEntry *entry_a = a;
+	const CacheEntry *entry_b = b;
+
+	return (entry_a->mtime > entry_b->mtime) - (entry_a->mtime < entry_b->mtime);
+}
+
+/* Recounts the size of the cache and drops the least recently used
+   entries when it is over the limit. Called with the lock held. */
+static void
+cache_trim (GSTEImageCache *cache)
+{
+	GDir       *dir;
+	const char *name;
+	GArray     *entries;
+	goffset     total;
+	goffset     target;
+	guint       i;
+
+	dir = g_dir_open (cache->dir, 0, NULL);
+	if (dir == NULL)
+	{
+		cache->total_size = 0;
+		return;
+	}
+
+	entries = g_array_new (FALSE, FALSE, sizeof (CacheEntry));
+	total = 0;
+
+	while ((name = g_dir_read_name (dir)) != NULL)
+	{
+		CacheEntry entry;
+		GStatBuf   st;
+
+		/* skips temporary files that are being written */
+		if (! g_str_has_suffix (name, CACHE_SUFFIX))
+		{
+			continue;
+		}
+
+		entry.path = g_build_filename (cache->dir, name, NULL);
+		if (g_stat (entry.path, &st) != 0)
+		{
+			g_free (entry.path);
+			continue;
+		}
+
+		entry.mtime = st.st_mtime;
+		entry.size = st.st_size;
+		total += entry.size;
+
+		g_array_append_val (entries, entry);
+	}
+
+	g_dir_close (dir);
+
+	if (total > cache->max_size)
+	{
+		target = cache->max_size / 100 * CACHE_TRIM_TARGET;
+
+		g_array_sort (entries, cache_entry_compare_mtime);
+
+		for (i = 0; i < entries->len && total > target; i++)
+		{
+			CacheEntry *entry = &g_array_index (entries, CacheEntry, i);
+
+			if (g_unlink (entry->path) == 0)
+			{
+				total -= entry->size;
+			}
+		}
+	}
+
+	for (i = 0; i < entries->len; i++)
+	{
+		g_free (g_array_index (entries, CacheEntry, i).path);
+	}
+	g_array_free (entries, TRUE);
+
+	cache->total_size = total;
+}
+
+void
+gste_image_cache_store (GSTEImageCache  *cache,
+                        const char      *key,
+                        cairo_surface_t *image)
+{
+	CacheHeader header;
+	char       *path;
+	char       *contents;
+	gsize       size;
+
+	g_return_if_fail (cache != NULL);
+	g_return_if_fail (key != NULL);
+	g_return_if_fail (image != NULL);
+
+	if (cairo_surface_get_type (image) != CAIRO_SURFACE_TYPE_IMAGE)
+	{
+		return;
+	}
+
+	cairo_surface_flush (image);
+
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, CACHE_MAGIC, sizeof (header.magic));
+	header.format = cairo_image_surface_get_format (image);
+	header.width = cairo_image_surface_get_width (image);
+	header.height = cairo_image_surface_get_height (image);
+	header.stride = cairo_image_surface_get_stride (image);
+	header.length = (guint64) header.stride * header.height;
+
+	if (header.format != CAIRO_FORMAT_ARGB32 && header.format != CAIRO_FORMAT_RGB24)
+	{
+		return;
+	}
+
+	size = sizeof (header) + header.length;
+	contents = g_malloc (size);
+	memcpy (contents, &header, sizeof (header));
+	memcpy (contents + sizeof (header), cairo_image_surface_get_data (image), header.length);
+
+	g_mkdir_with_parents (cache->dir, 0700);
+
+	/* written to a temporary file and renamed, readers never see
+	 * a partial entry */
+	path = g_build_filename (cache->dir, key, NULL);
+	if (! g_file_set_contents (path, contents, size, NULL))
+	{
+		size = 0;
+	}
+
+	g_free (path);
+	g_free (contents);
+
+	g_mutex_lock (&cache->lock);
+
+	if (cache->total_size < 0)
+	{
+		cache_trim (cache);
+	}
+	else
+	{
+		cache->total_size += size;
+
+		if (cache->total_size > cache->max_size)
+		{
+			cache_trim (cache);
+		}
+	}
+
+	g_mutex_unlock (&cache->lock);
+}
@@ -0,0 +1,54 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __GSTE_IMAGE_CACHE_H
+#define __GSTE_IMAGE_CACHE_H
+
+#include <glib.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+/* On-disk cache of images already scaled for a given screen size.
+   All functions may be called from any thread. */
+typedef struct GSTEImageCache GSTEImageCache;
+
+GSTEImageCache *gste_image_cache_new      (const char     *name,
+        goffset         max_size);
+void            gste_image_cache_free     (GSTEImageCache *cache);
+
+void            gste_image_cache_set_max_size (GSTEImageCache *cache,
+        goffset         max_size);
+
+char           *gste_image_cache_get_key  (GSTEImageCache *cache,
+        const char     *filename,
+        int             width,
+        int             height,
+        gboolean        no_stretch_hint,
+        gboolean        cover);
+cairo_surface_t *gste_image_cache_lookup  (GSTEImageCache  *cache,
+        const char      *key);
+void            gste_image_cache_store    (GSTEImageCache  *cache,
+        const char      *key,
+        cairo_surface_t *image);
+
+G_END_DECLS
+
+#endif /* __GSTE_IMAGE_CACHE_H */
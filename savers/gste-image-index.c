@@ -0,0 +1,946 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 8; tab-width: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "gste-image-index.h"
+
+/* The index remembers, for every directory, its mtime and the images
+   and subdirectories found in it. Adding, removing or renaming an
+   entry changes the mtime of its directory, so on later scans a
+   directory whose mtime did not change is not read again; only the
+   directories themselves are stat()ed. */
+
+#define INDEX_MAGIC "GSTEINDEX1"
+
+typedef struct
+{
+	gint64     mtime;
+	/* names of the images and of the subdirectories */
+	GPtrArray *files;
+	GPtrArray *dirs;
+} DirRecord;
+
+struct GSTEImageIndex
+{
+	char       *base;
+	char       *index_path;
+
+	/* directory path -> DirRecord, from the last scan */
+	GHashTable *dirs;
+
+	/* full paths of the images, the ones before pos have been
+	 * handed out in this round; removed ones are left as NULL */
+	GPtrArray  *files;
+	/* path in files -> its position */
+	GHashTable *positions;
+	guint       pos;
+	gboolean    is_sorted;
+	gboolean    scanned;
+
+	/* changes whenever the set of directories does */
+	guint       serial;
+
+	/* indexes of the same directory in other processes hand out
+	 * the other shares; the images of this one in files */
+	guint       share;
+	guint       n_shares;
+	guint       n_in_share;
+};
+
+static gboolean
+in_share (GSTEImageIndex *index,
+          const char     *path)
+{
+	/* g_str_hash() is the same in every process */
+	return index->n_shares <= 1 || g_str_hash (path) % index->n_shares == index->share;
+}
+
+static void
+index_set_position (GSTEImageIndex *index,
+                    guint           i)
+{
+	g_hash_table_insert (index->positions,
+	                     g_ptr_array_index (index->files, i),
+	                     GUINT_TO_POINTER (i));
+}
+
+static void
+index_append_file (GSTEImageIndex *index,
+                   char           *path)
+{
+	g_ptr_array_add (index->files, path);
+	index_set_position (index, index->files->len - 1);
+
+	if (in_share (index, path))
+	{
+		index->n_in_share++;
+	}
+}
+
+static void
+index_remove_at (GSTEImageIndex *index,
+                 guint           i)
+{
+	char *path;
+
+	path = g_ptr_array_index (index->files, i);
+	g_hash_table_remove (index->positions, path);
+
+	if (in_share (index, path))
+	{
+		index->n_in_share--;
+	}
+
+	/* a hole keeps the order of the others */
+	index->files->pdata[i] = NULL;
+	g_free (path);
+}
+
+static DirRecord *
+dir_record_new (gint64 mtime)
+{
+	DirRecord *record;
+
+	record = g_new (DirRecord, 1);
+	record->mtime = mtime;
+	record->files = g_ptr_array_new_with_free_func (g_free);
+	record->dirs = g_ptr_array_new_with_free_func (g_free);
+
+	return record;
+}
+
+static void
+dir_record_free (DirRecord *record)
+{
+	g_ptr_array_unref (record->files);
+	g_ptr_array_unref (record->dirs);
+	g_free (record);
+}
+
+static GHashTable *
+dir_table_new (void)
+{
+	return g_hash_table_new_full (g_str_hash,
+	                              g_str_equal,
+	                              g_free,
+	                              (GDestroyNotify)dir_record_free);
+}
+
+static gpointer
+build_extensions (gpointer data)
+{
+	GHashTable *extensions;
+	GSList     *formats;
+	GSList     *l;
+
+	extensions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	formats = gdk_pixbuf_get_formats ();
+	for (l = formats; l != NULL; l = l->next)
+	{
+		char **exts;
+		int    i;
+
+		exts = gdk_pixbuf_format_get_extensions (l->data);
+		for (i = 0; exts != NULL && exts[i] != NULL; i++)
+		{
+			g_hash_table_add (extensions, g_ascii_strdown (exts[i], -1));
+		}
+		g_strfreev (exts);
+	}
+	g_slist_free (formats);
+
+	return extensions;
+}
+
+/* only files gdk-pixbuf has a loader for are candidates */
+static gboolean
+is_image_name (const char *name)
+{
+	static GOnce  once = G_ONCE_INIT;
+	GHashTable   *extensions;
+	const char   *dot;
+	char         *ext;
+	gboolean      ret;
+
+	extensions = g_once (&once, build_extensions, NULL);
+
+	dot = strrchr (name, '.');
+	if (dot == NULL || dot[1] == '\0')
+	{
+		return FALSE;
+	}
+
+	ext = g_ascii_strdown (dot + 1, -1);
+	ret = g_hash_table_contains (extensions, ext);
+	g_free (ext);
+
+	return ret;
+}
+
+static DirRecord *
+read_dir (const char *path,
+          gint64      mtime)
+{
+	DirRecord     *record;
+	DIR           *d;
+	struct dirent *entry;
+
+	d = opendir (path);
+	if (d == NULL)
+	{
+		g_warning ("Could not open directory: %s", path);
+		return NULL;
+	}
+
+	record = dir_record_new (mtime);
+
+	while ((entry = readdir (d)) != NULL)
+	{
+		gboolean is_dir;
+		gboolean is_file;
+
+		/* skip hidden files */
+		if (entry->d_name[0] == '.')
+		{
+			continue;
+		}
+
+		is_dir = FALSE;
+		is_file = FALSE;
+
+#ifdef _DIRENT_HAVE_D_TYPE
+		/* avoids a stat() per entry on file systems that know */
+		if (entry->d_type == DT_DIR)
+		{
+			is_dir = TRUE;
+		}
+		else if (entry->d_type == DT_REG)
+		{
+			is_file = TRUE;
+		}
+		else if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN)
+#endif
+		{
+			GStatBuf st;
+			char    *child;
+
+			child = g_build_filename (path, entry->d_name, NULL);
+			if (g_stat (child, &st) == 0)
+			{
+				is_dir = S_ISDIR (st.st_mode);
+				is_file = S_ISREG (st.st_mode);
+			}
+			g_free (child);
+		}
+
+		if (is_dir)
+		{
+			g_ptr_array_add (record->dirs, g_strdup (entry->d_name));
+		}
+		else if (is_file && is_image_name (entry->d_name))
+		{
+			g_ptr_array_add (record->files, g_strdup (entry->d_name));
+		}
+	}
+
+	closedir (d);
+
+	return record;
+}
+
+static void
+scan_dir (GSTEImageIndex *index,
+          const char     *path,
+          GHashTable     *old_dirs,
+          GHashTable     *new_dirs,
+          GHashTable     *visited,
+          gboolean       *changed)
+{
+	GStatBuf   st;
+	DirRecord *record;
+	gpointer   old_path;
+	gpointer   old_record;
+	char      *id;
+	guint      i;
+
+	if (g_stat (path, &st) != 0 || ! S_ISDIR (st.st_mode))
+	{
+		return;
+	}
+
+	/* symlinks can make loops */
+	id = g_strdup_printf ("%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT,
+	                      (guint64) st.st_dev, (guint64) st.st_ino);
+	if (g_hash_table_contains (visited, id))
+	{
+		g_free (id);
+		return;
+	}
+	g_hash_table_add (visited, id);
+
+	if (g_hash_table_contains (new_dirs, path))
+	{
+		return;
+	}
+
+	record = NULL;
+	if (g_hash_table_lookup_extended (old_dirs, path, &old_path, &old_record))
+	{
+		g_hash_table_steal (old_dirs, path);
+		g_free (old_path);
+
+		if (((DirRecord *) old_record)->mtime == (gint64) st.st_mtime)
+		{
+			record = old_record;
+		}
+		else
+		{
+			dir_record_free (old_record);
+		}
+	}
+
+	if (record == NULL)
+	{
+		record = read_dir (path, st.st_mtime);
+		if (record == NULL)
+		{
+			return;
+		}
+		*changed = TRUE;
+	}
+
+	g_hash_table_insert (new_dirs, g_strdup (path), record);
+
+	for (i = 0; i < record->files->len; i++)
+	{
+		index_append_file (index,
+		                   g_build_filename (path, g_ptr_array_index (record->files, i), NULL));
+	}
+
+	for (i = 0; i < record->dirs->len; i++)
+	{
+		char *child;
+
+		child = g_build_filename (path, g_ptr_array_index (record->dirs, i), NULL);
+		scan_dir (index, child, old_dirs, new_dirs, visited, changed);
+		g_free (child);
+	}
+}
+
+static GHashTable *
+index_load (GSTEImageIndex *index)
+{
+	GHashTable *dirs;
+	DirRecord  *record;
+	char       *contents;
+	char       *line;
+	char       *next;
+
+	dirs = dir_table_new ();
+
+	if (! g_file_get_contents (index->index_path, &contents, NULL, NULL))
+	{
+		return dirs;
+	}
+
+	if (! g_str_has_prefix (contents, INDEX_MAGIC "\n"))
+	{
+		g_free (contents);
+		return dirs;
+	}
+
+	record = NULL;
+	for (line = contents + strlen (INDEX_MAGIC "\n"); *line != '\0'; line = next)
+	{
+		char *value;
+
+		next = strchr (line, '\n');
+		if (next == NULL)
+		{
+			/* truncated */
+			break;
+		}
+		*next++ = '\0';
+
+		if (line[0] == '\0' || line[1] != '\t')
+		{
+			continue;
+		}
+
+		value = g_strcompress (line + 2);
+
+		if (line[0] == 'D')
+		{
+			char *path;
+
+			/* D <mtime> <path> */
+			path = strchr (value, '\t');
+			if (path != NULL)
+			{
+				*path++ = '\0';
+				record = dir_record_new (g_ascii_strtoll (value, NULL, 10));
+				g_hash_table_insert (dirs, g_strdup (path), record);
+			}
+			g_free (value);
+		}
+		else if (line[0] == 'f' && record != NULL)
+		{
+			g_ptr_array_add (record->files, value);
+		}
+		else if (line[0] == 'd' && record != NULL)
+		{
+			g_ptr_array_add (record->dirs, value);
+		}
+		else
+		{
+			g_free (value);
+		}
+	}
+
+	g_free (contents);
+
+	return dirs;
+}
+
+static void
+append_escaped (GString    *str,
+                char        type,
+                const char *value)
+{
+	char *escaped;
+
+	/* keeps names with newlines on one line */
+	escaped = g_strescape (value, NULL);
+	g_string_append_printf (str, "%c\t%s\n", type, escaped);
+	g_free (escaped);
+}
+
+static void
+index_save (GSTEImageIndex *index)
+{
+	GHashTableIter iter;
+	gpointer       path;
+	gpointer       value;
+	GString       *str;
+	char          *dir;
+
+	str = g_string_new (INDEX_MAGIC "\n");
+
+	g_hash_table_iter_init (&iter, index->dirs);
+	while (g_hash_table_iter_next (&iter, &path, &value))
+	{
+		DirRecord *record = value;
+		char      *header;
+		guint      i;
+
+		header = g_strdup_printf ("%" G_GINT64_FORMAT "\t%s", record->mtime, (char *) path);
+		append_escaped (str, 'D', header);
+		g_free (header);
+
+		for (i = 0; i < record->files->len; i++)
+		{
+			append_escaped (str, 'f', g_ptr_array_index (record->files, i));
+		}
+
+		for (i = 0; i < record->dirs->len; i++)
+		{
+			append_escaped (str, 'd', g_ptr_array_index (record->dirs, i));
+		}
+	}
+
+	dir = g_path_get_dirname (index->index_path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	g_file_set_contents (index->index_path, str->str, str->len, NULL);
+
+	g_string_free (str, TRUE);
+}
+
+/* Slideshows on several monitors start at the same time; the first
+   one scans and the others wait for it and load what it saved. */
+static int
+index_lock (GSTEImageIndex *index)
+{
+	char *dir;
+	char *path;
+	int   fd;
+
+	dir = g_path_get_dirname (index->index_path);
+	g_mkdir_with_parents (dir, 0700);
+	g_free (dir);
+
+	path = g_strconcat (index->index_path, ".lock", NULL);
+	fd = g_open (path, O_RDWR | O_CREAT, 0600);
+	g_free (path);
+
+	if (fd >= 0 && flock (fd, LOCK_EX) != 0)
+	{
+		close (fd);
+		fd = -1;
+	}
+
+	return fd;
+}
+
+static void
+index_unlock (int fd)
+{
+	if (fd >= 0)
+	{
+		flock (fd, LOCK_UN);
+		close (fd);
+	}
+}
+
+static void
+index_scan (GSTEImageIndex *index)
+{
+	GHashTable *new_dirs;
+	GHashTable *visited;
+	gboolean    changed;
+	int         lock_fd;
+
+	/* without the lock every process just scans on its own */
+	lock_fd = index_lock (index);
+
+	if (index->dirs == NULL)
+	{
+		index->dirs = index_load (index);
+	}
+
+	new_dirs = dir_table_new ();
+	visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	changed = FALSE;
+
+	g_hash_table_remove_all (index->positions);
+	g_ptr_array_set_size (index->files, 0);
+	index->n_in_share = 0;
+	index->pos = 0;
+	index->is_sorted = FALSE;
+
+	scan_dir (index, index->base, index->dirs, new_dirs, visited, &changed);
+
+	/* what is left are directories that went away */
+	if (g_hash_table_size (index->dirs) > 0)
+	{
+		changed = TRUE;
+	}
+
+	g_hash_table_destroy (index->dirs);
+	g_hash_table_destroy (visited);
+	index->dirs = new_dirs;
+	index->scanned = TRUE;
+	index->serial++;
+
+	if (changed)
+	{
+		index_save (index);
+	}
+
+	index_unlock (lock_fd);
+}
+
+GSTEImageIndex *
+gste_image_index_new (const char *base)
+{
+	GSTEImageIndex *index;
+	char           *digest;
+	char           *name;
+
+	g_return_val_if_fail (base != NULL, NULL);
+
+	index = g_new0 (GSTEImageIndex, 1);
+
+	index->base = g_strdup (base);
+	index->files = g_ptr_array_new_with_free_func (g_free);
+	index->positions = g_hash_table_new (g_str_hash, g_str_equal);
+
+	digest = g_compute_checksum_for_string (G_CHECKSUM_SHA1, base, -1);
+	name = g_strconcat (digest, ".index", NULL);
+	index->index_path = g_build_filename (g_get_user_cache_dir (),
+	                                      "mate-screensaver",
+	                                      "slideshow",
+	                                      name,
+	                                      NULL);
+	g_free (name);
+	g_free (digest);
+
+	return index;
+}
+
+void
+gste_image_index_free (GSTEImageIndex *index)
+{
+	if (index == NULL)
+	{
+		return;
+	}
+
+	if (index->dirs != NULL)
+	{
+		g_hash_table_destroy (index->dirs);
+	}
+
+	g_hash_table_destroy (index->positions);
+	g_ptr_array_unref (index->files);
+	g_free (index->index_path);
+	g_free (index->base);
+	g_free (index);
+}
+
+const char *
+gste_image_index_get_base (GSTEImageIndex *index)
+{
+	g_return_val_if_fail (index != NULL, NULL);
+
+	return index->base;
+}
+
+static int
+compare_paths (gconstpointer a,
+               gconstpointer b)
+{
+	const char *path_a = *(const char **) a;
+	const char *path_b = *(const char **) b;
+
+	/* holes go last */
+	if (path_a == NULL || path_b == NULL)
+	{
+		return (path_a == NULL) - (path_b == NULL);
+	}
+
+	return strcmp (path_a, path_b);
+}
+
+static void
+index_swap (GSTEImageIndex *index,
+            guint           i,
+            guint           j)
+{
+	gpointer tmp;
+
+	tmp = index->files->pdata[i];
+	index->files->pdata[i] = index->files->pdata[j];
+	index->files->pdata[j] = tmp;
+
+	if (index->files->pdata[i] != NULL)
+	{
+		index_set_position (index, i);
+	}
+	if (index->files->pdata[j] != NULL)
+	{
+		index_set_position (index, j);
+	}
+}
+
+static void
+index_sort_remaining (GSTEImageIndex *index)
+{
+	guint i;
+
+	qsort (index->files->pdata + index->pos,
+	       index->files->len - index->pos,
+	       sizeof (gpointer),
+	       compare_paths);
+
+	for (i = index->pos; i < index->files->len; i++)
+	{
+		if (index->files->pdata[i] != NULL)
+		{
+			index_set_position (index, i);
+		}
+	}
+
+	index->is_sorted = TRUE;
+}
+
+/* Returns the next image to show. Every image is handed out once
+   before the directory is scanned again and a new round starts. */
+char *
+gste_image_index_next (GSTEImageIndex *index,
+                       gboolean        sorted)
+{
+	gboolean    rescanned;
+	const char *path;
+	char       *filename;
+
+	g_return_val_if_fail (index != NULL, NULL);
+
+	rescanned = FALSE;
+	filename = NULL;
+
+	while (filename == NULL)
+	{
+		if (! index->scanned || index->pos >= index->files->len)
+		{
+			/* only holes were left */
+			if (rescanned)
+			{
+				return NULL;
+			}
+
+			index_scan (index);
+			rescanned = TRUE;
+		}
+
+		if (index->files->len == 0)
+		{
+			return NULL;
+		}
+
+		if (sorted)
+		{
+			/* only the part of this round that is still to come */
+			if (! index->is_sorted)
+			{
+				index_sort_remaining (index);
+			}
+		}
+		else
+		{
+			/* shuffle bag: swap a random remaining entry in */
+			index_swap (index,
+			            index->pos,
+			            g_random_int_range (index->pos, index->files->len));
+			index->is_sorted = FALSE;
+		}
+
+		path = g_ptr_array_index (index->files, index->pos);
+		index->pos++;
+
+		/* images of the other shares are left to the other
+		 * processes, unless there are none for this one */
+		if (path != NULL && (index->n_in_share == 0 || in_share (index, path)))
+		{
+			filename = g_strdup (path);
+		}
+	}
+
+	return filename;
+}
+
+/* Splits the images between n_shares indexes of the same directory,
+   this one only hands out those of the given share. */
+void
+gste_image_index_set_share (GSTEImageIndex *index,
+                            guint           share,
+                            guint           n_shares)
+{
+	guint i;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (n_shares == 0 || share < n_shares);
+
+	if (index->share == share && index->n_shares == n_shares)
+	{
+		return;
+	}
+
+	index->share = share;
+	index->n_shares = n_shares;
+	index->n_in_share = 0;
+
+	for (i = 0; i < index->files->len; i++)
+	{
+		const char *path = g_ptr_array_index (index->files, i);
+
+		if (path != NULL && in_share (index, path))
+		{
+			index->n_in_share++;
+		}
+	}
+}
+
+static gboolean
+is_below (const char *path,
+          const char *dir)
+{
+	gsize len;
+
+	len = strlen (dir);
+	if (len > 0 && dir[len - 1] == G_DIR_SEPARATOR)
+	{
+		len--;
+	}
+
+	return strncmp (path, dir, len) == 0
+	       && (path[len] == G_DIR_SEPARATOR || path[len] == '\0');
+}
+
+/* Adds an image that appeared after the last scan, it is shown in
+   the current round. */
+void
+gste_image_index_add_file (GSTEImageIndex *index,
+                           const char     *path)
+{
+	char *basename;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (path != NULL);
+
+	if (! index->scanned
+	        || ! is_below (path, index->base)
+	        || g_hash_table_contains (index->positions, path))
+	{
+		return;
+	}
+
+	basename = g_path_get_basename (path);
+	if (basename[0] != '.' && is_image_name (basename))
+	{
+		index_append_file (index, g_strdup (path));
+		index->is_sorted = FALSE;
+	}
+	g_free (basename);
+}
+
+/* Adds a directory that appeared after the last scan, with
+   everything below it. */
+void
+gste_image_index_add_dir (GSTEImageIndex *index,
+                          const char     *path)
+{
+	GHashTable *old_dirs;
+	GHashTable *visited;
+	gboolean    changed;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (path != NULL);
+
+	if (! index->scanned
+	        || ! is_below (path, index->base)
+	        || g_hash_table_contains (index->dirs, path))
+	{
+		return;
+	}
+
+	old_dirs = dir_table_new ();
+	visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	changed = FALSE;
+
+	scan_dir (index, path, old_dirs, index->dirs, visited, &changed);
+
+	g_hash_table_destroy (visited);
+	g_hash_table_destroy (old_dirs);
+
+	index->is_sorted = FALSE;
+	index->serial++;
+}
+
+/* Forgets a file, or a directory and everything below it, so it is
+   not handed out any more. */
+void
+gste_image_index_remove (GSTEImageIndex *index,
+                         const char     *path)
+{
+	GHashTableIter iter;
+	gpointer       key;
+	gpointer       value;
+	guint          i;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (path != NULL);
+
+	if (! index->scanned)
+	{
+		return;
+	}
+
+	if (g_hash_table_lookup_extended (index->positions, path, NULL, &value))
+	{
+		index_remove_at (index, GPOINTER_TO_UINT (value));
+		return;
+	}
+
+	if (! g_hash_table_contains (index->dirs, path))
+	{
+		return;
+	}
+
+	for (i = 0; i < index->files->len; i++)
+	{
+		const char *file = g_ptr_array_index (index->files, i);
+
+		if (file != NULL && is_below (file, path))
+		{
+			index_remove_at (index, i);
+		}
+	}
+
+	g_hash_table_iter_init (&iter, index->dirs);
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+	{
+		if (is_below (key, path))
+		{
+			g_hash_table_iter_remove (&iter);
+		}
+	}
+
+	index->serial++;
+}
+
+guint
+gste_image_index_get_serial (GSTEImageIndex *index)
+{
+	g_return_val_if_fail (index != NULL, 0);
+
+	return index->serial;
+}
+
+/* Returns the directories that were scanned, for watching them */
+GPtrArray *
+gste_image_index_get_dirs (GSTEImageIndex *index)
+{
+	GHashTableIter iter;
+	GPtrArray     *dirs;
+	gpointer       key;
+
+	g_return_val_if_fail (index != NULL, NULL);
+
+	dirs = g_ptr_array_new_with_free_func (g_free);
+
+	if (index->dirs != NULL)
+	{
+		g_hash_table_iter_init (&iter, index->dirs);
+		while (g_hash_table_iter_next (&iter, &key, NULL))
+		{
+			g_ptr_array_add (dirs, g_strdup (key));
+		}
+	}
+
+	return dirs;
+}
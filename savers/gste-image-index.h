@@ -0,0 +1,57 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __GSTE_IMAGE_INDEX_H
+#define __GSTE_IMAGE_INDEX_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* List of the images below a directory, kept on disk between runs so
+   that only directories that changed are read again. Not thread-safe,
+   callers serialize access. */
+typedef struct GSTEImageIndex GSTEImageIndex;
+
+GSTEImageIndex *gste_image_index_new      (const char     *base);
+void            gste_image_index_free     (GSTEImageIndex *index);
+
+const char     *gste_image_index_get_base (GSTEImageIndex *index);
+
+char           *gste_image_index_next     (GSTEImageIndex *index,
+        gboolean        sorted);
+
+void            gste_image_index_set_share (GSTEImageIndex *index,
+        guint           share,
+        guint           n_shares);
+
+void            gste_image_index_add_file (GSTEImageIndex *index,
+        const char     *path);
+void            gste_image_index_add_dir  (GSTEImageIndex *index,
+        const char     *path);
+void            gste_image_index_remove   (GSTEImageIndex *index,
+        const char     *path);
+
+guint           gste_image_index_get_serial (GSTEImageIndex *index);
+GPtrArray      *gste_image_index_get_dirs (GSTEImageIndex *index);
+
+G_END_DECLS
+
+#endif /* __GSTE_IMAGE_INDEX_H */
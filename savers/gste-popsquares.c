@@ -36,28 +36,62 @@
 static void     gste_popsquares_finalize   (GObject             *object);
 static void     draw_frame                 (GSTEPopsquares      *pop,
                                             cairo_t *cr);
-
-typedef struct _square
-{
-	int x, y, w, h;
-	int color;
-} square;
+static void     gste_popsquares_tick       (GSThemeEngine       *engine,
+                                            gint64               frame_time);
+static void     setup_squares              (GSTEPopsquares      *pop);
+static void     setup_colors               (GSTEPopsquares      *pop);
+static void     update_surface             (GSTEPopsquares      *pop);
 
 struct GSTEPopsquaresPrivate
 {
-	guint timeout_id;
+	/* frame time the colors were last advanced at */
+	gint64     last_frame;
 
 	int        ncolors;
 	int        subdivision;
 
 	GdkRGBA   *colors;
-	square    *squares;
+	/* the ramp as it ends up on screen, 0xRRGGBB; neighbouring steps
+	 * often look the same */
+	guint32   *palette;
+
+	/* every cell's position on the ramp, row by row, and the one it
+	 * was last drawn with; there are grid_size cells to a row and
+	 * column, fewer than asked for when the window is too small */
+	int        grid_size;
+	int        cell_width;
+	int        cell_height;
+	guint8    *cells;
+	guint8    *drawn;
+	gboolean   redraw_all;
+
+	/* what is shown; only cells that look different are drawn into
+	 * it, and only those are invalidated */
+	cairo_surface_t *surf;
+	/* scratch space for the cells to draw, and their rectangles */
+	guint     *changed;
+	cairo_rectangle_int_t *rects;
+};
+
+enum
+{
+	PROP_0,
+	PROP_SUBDIVISION
 };
 
 static GObjectClass *parent_class = NULL;
 
 G_DEFINE_TYPE_WITH_PRIVATE (GSTEPopsquares, gste_popsquares, GS_TYPE_THEME_ENGINE)
 
+#define DEFAULT_SUBDIVISION 5
+#define MAX_SUBDIVISION 400
+/* ramp positions are kept in bytes */
+#define MAX_COLORS 256
+
+/* every square moves one step along the color ramp this often, in
+ * microseconds */
+#define COLOR_STEP_TIME 25000
+
 static void
 hsv_to_rgb (int     h,
             double  s,
@@ -272,18 +306,15 @@ make_color_ramp (int          h1,
 }
 
 static void
-randomize_square_colors (square *squares,
+randomize_square_colors (guint8 *cells,
                          int     nsquares,
                          int     ncolors)
 {
-	int     i;
-	square *s;
-
-	s = squares;
+	int i;
 
 	for (i = 0; i < nsquares; i++)
 	{
-		s[i].color = g_random_int_range (0, ncolors);
+		cells[i] = g_random_int_range (0, ncolors);
 	}
 }
 
@@ -322,10 +353,21 @@ gste_popsquares_set_property (GObject            *object,
                               const GValue       *value,
                               GParamSpec         *pspec)
 {
-	GSTE_POPSQUARES (object);
+	GSTEPopsquares *self;
+
+	self = GSTE_POPSQUARES (object);
 
 	switch (prop_id)
 	{
+	case PROP_SUBDIVISION:
+		self->priv->subdivision = g_value_get_int (value);
+		if (self->priv->cells != NULL)
+		{
+			setup_squares (self);
+			setup_colors (self);
+			update_surface (self);
+		}
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -338,24 +380,38 @@ gste_popsquares_get_property (GObject            *object,
                               GValue             *value,
                               GParamSpec         *pspec)
 {
-	GSTE_POPSQUARES (object);
+	GSTEPopsquares *self;
+
+	self = GSTE_POPSQUARES (object);
 
 	switch (prop_id)
 	{
+	case PROP_SUBDIVISION:
+		g_value_set_int (value, self->priv->subdivision);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
 	}
 }
 
+static void
+free_squares (GSTEPopsquares *pop)
+{
+	g_clear_pointer (&pop->priv->cells, g_free);
+	g_clear_pointer (&pop->priv->drawn, g_free);
+	g_clear_pointer (&pop->priv->changed, g_free);
+	g_clear_pointer (&pop->priv->rects, g_free);
+	g_clear_pointer (&pop->priv->surf, cairo_surface_destroy);
+}
+
 static void
 setup_squares (GSTEPopsquares *pop)
 {
 	int       window_width;
 	int       window_height;
 	int       nsquares;
-	int       x, y;
-	int       sw, sh, gw, gh;
+	cairo_t  *cr;
 	GdkWindow *window;
 
 	window = gs_theme_engine_get_window (GS_THEME_ENGINE (pop));
@@ -367,30 +423,35 @@ setup_squares (GSTEPopsquares *pop)
 
 	gs_theme_engine_get_window_size (GS_THEME_ENGINE (pop), &window_width, &window_height);
 
-	sw = window_width / pop->priv->subdivision;
-	sh = window_height / pop->priv->subdivision;
+	/* keep the cells at least 2 pixels across, so they are still
+	 * visible next to the 1 pixel gap */
+	pop->priv->grid_size = MIN (pop->priv->subdivision,
+	                            MIN (window_width, window_height) / 2);
+	pop->priv->grid_size = MAX (pop->priv->grid_size, 1);
 
-	gw = pop->priv->subdivision;
-	gh = pop->priv->subdivision;
-	nsquares = gw * gh;
+	pop->priv->cell_width = window_width / pop->priv->grid_size;
+	pop->priv->cell_height = window_height / pop->priv->grid_size;
 
-	if (pop->priv->squares)
-	{
-		g_free (pop->priv->squares);
-	}
-	pop->priv->squares = g_new0 (square, nsquares);
+	nsquares = pop->priv->grid_size * pop->priv->grid_size;
 
-	for (y = 0; y < gh; y++)
-	{
-		for (x = 0; x < gw; x++)
-		{
-			square *s = (square *) &pop->priv->squares [gw * y + x];
-			s->w = sw;
-			s->h = sh;
-			s->x = x * sw;
-			s->y = y * sh;
-		}
-	}
+	free_squares (pop);
+	pop->priv->cells = g_new0 (guint8, nsquares);
+	pop->priv->drawn = g_new0 (guint8, nsquares);
+	pop->priv->changed = g_new (guint, nsquares);
+	pop->priv->rects = g_new (cairo_rectangle_int_t, nsquares);
+
+	pop->priv->surf = gdk_window_create_similar_surface (window,
+	                  CAIRO_CONTENT_COLOR,
+	                  window_width,
+	                  window_height);
+
+	/* the gaps between the squares */
+	cr = cairo_create (pop->priv->surf);
+	cairo_set_source_rgb (cr, 0, 0, 0);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+
+	pop->priv->redraw_all = TRUE;
 }
 
 static void
@@ -399,13 +460,14 @@ setup_colors (GSTEPopsquares *pop)
 	double    s1, v1, s2, v2 = 0;
 	int       h1, h2 = 0;
 	int       nsquares;
+	int       i;
 	GdkRGBA   fg;
 	GdkRGBA   bg;
 	GdkWindow *window;
 
 	window = gs_theme_engine_get_window (GS_THEME_ENGINE (pop));
 
-	if (window == NULL)
+	if (window == NULL || pop->priv->cells == NULL)
 	{
 		return;
 	}
@@ -427,9 +489,23 @@ setup_colors (GSTEPopsquares *pop)
 	                 pop->priv->ncolors,
 	                 TRUE);
 
-	nsquares = pop->priv->subdivision * pop->priv->subdivision;
+	g_free (pop->priv->palette);
+	pop->priv->palette = g_new (guint32, pop->priv->ncolors);
+
+	for (i = 0; i < pop->priv->ncolors; i++)
+	{
+		GdkRGBA *c = &pop->priv->colors [i];
+
+		pop->priv->palette [i] = ((guint32) (c->red * 255 + 0.5) << 16)
+		                         | ((guint32) (c->green * 255 + 0.5) << 8)
+		                         | (guint32) (c->blue * 255 + 0.5);
+	}
 
-	randomize_square_colors (pop->priv->squares, nsquares, pop->priv->ncolors);
+	nsquares = pop->priv->grid_size * pop->priv->grid_size;
+
+	randomize_square_colors (pop->priv->cells, nsquares, pop->priv->ncolors);
+
+	pop->priv->redraw_all = TRUE;
 }
 
 static void
@@ -440,6 +516,10 @@ gste_popsquares_real_show (GtkWidget *widget)
 	/* start */
 	setup_squares (pop);
 	setup_colors (pop);
+	update_surface (pop);
+
+	pop->priv->last_frame = 0;
+	gs_theme_engine_start_ticks (GS_THEME_ENGINE (pop));
 
 	if (GTK_WIDGET_CLASS (parent_class)->show)
 	{
@@ -451,11 +531,18 @@ static gboolean
 gste_popsquares_real_draw (GtkWidget *widget,
                            cairo_t   *cr)
 {
-	if (GTK_WIDGET_CLASS (parent_class)->draw) {
-		GTK_WIDGET_CLASS (parent_class)->draw (widget, cr);
+	GSTEPopsquares *pop = GSTE_POPSQUARES (widget);
+
+	if (pop->priv->surf == NULL)
+	{
+		if (GTK_WIDGET_CLASS (parent_class)->draw) {
+			GTK_WIDGET_CLASS (parent_class)->draw (widget, cr);
+		}
+
+		return TRUE;
 	}
 
-	draw_frame (GSTE_POPSQUARES (widget), cr);
+	draw_frame (pop, cr);
 
 	return TRUE;
 }
@@ -472,6 +559,7 @@ gste_popsquares_real_configure (GtkWidget         *widget,
 	/* just reset everything */
 	setup_squares (pop);
 	setup_colors (pop);
+	update_surface (pop);
 
 	/* schedule a redraw */
 	gtk_widget_queue_draw (widget);
@@ -487,8 +575,9 @@ gste_popsquares_real_configure (GtkWidget         *widget,
 static void
 gste_popsquares_class_init (GSTEPopsquaresClass *klass)
 {
-	GObjectClass   *object_class = G_OBJECT_CLASS (klass);
-	GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+	GObjectClass       *object_class = G_OBJECT_CLASS (klass);
+	GtkWidgetClass     *widget_class = GTK_WIDGET_CLASS (klass);
+	GSThemeEngineClass *engine_class = GS_THEME_ENGINE_CLASS (klass);
 
 	parent_class = g_type_class_peek_parent (klass);
 
@@ -499,83 +588,240 @@ gste_popsquares_class_init (GSTEPopsquaresClass *klass)
 	widget_class->show = gste_popsquares_real_show;
 	widget_class->draw = gste_popsquares_real_draw;
 	widget_class->configure_event = gste_popsquares_real_configure;
+
+	engine_class->tick = gste_popsquares_tick;
+
+	g_object_class_install_property (object_class,
+	                                 PROP_SUBDIVISION,
+	                                 g_param_spec_int ("subdivision",
+	                                         NULL,
+	                                         NULL,
+	                                         1,
+	                                         MAX_SUBDIVISION,
+	                                         DEFAULT_SUBDIVISION,
+	                                         G_PARAM_READWRITE));
 }
 
+/* Draws the cells whose color looks different from what was drawn
+   last, one fill per color, and invalidates just them */
 static void
-draw_frame (GSTEPopsquares *pop,
-            cairo_t        *cr)
+update_surface (GSTEPopsquares *pop)
 {
-	int      border = 1;
-	gboolean twitch = FALSE;
-	int      x, y;
-	int      gw, gh;
-	int      nsquares;
-	int      window_width;
-	int      window_height;
-	GdkWindow *window;
+	int       border = 1;
+	guint     start[MAX_COLORS + 1];
+	guint     next[MAX_COLORS];
+	guint     n_changed;
+	guint     n_rects;
+	int       gw;
+	int       nsquares;
+	int       i;
+	int       c;
+	cairo_t  *cr;
 
-	window = gs_theme_engine_get_window (GS_THEME_ENGINE (pop));
+	if (pop->priv->surf == NULL || pop->priv->palette == NULL)
+	{
+		return;
+	}
 
-	if (window == NULL)
+	gw = pop->priv->grid_size;
+	nsquares = gw * gw;
+
+	/* counting sort of the changed cells by color */
+	memset (start, 0, sizeof (start));
+	n_changed = 0;
+	for (i = 0; i < nsquares; i++)
+	{
+		guint8 color = pop->priv->cells [i];
+
+		if (pop->priv->redraw_all
+		        || pop->priv->palette [color] != pop->priv->palette [pop->priv->drawn [i]])
+		{
+			start[color + 1]++;
+			n_changed++;
+		}
+	}
+
+	if (n_changed == 0)
 	{
 		return;
 	}
 
-	gs_theme_engine_get_window_size (GS_THEME_ENGINE (pop),
-	                                 &window_width,
-	                                 &window_height);
+	for (c = 1; c <= pop->priv->ncolors; c++)
+	{
+		start[c] += start[c - 1];
+	}
+	memcpy (next, start, sizeof (next));
+
+	/* the rectangles are in row order, so runs in a row merge */
+	n_rects = 0;
+	for (i = 0; i < nsquares; i++)
+	{
+		guint8 color = pop->priv->cells [i];
+		cairo_rectangle_int_t *rect;
+
+		if (! pop->priv->redraw_all
+		        && pop->priv->palette [color] == pop->priv->palette [pop->priv->drawn [i]])
+		{
+			continue;
+		}
+
+		pop->priv->changed [next[color]++] = i;
+
+		rect = n_rects > 0 ? &pop->priv->rects [n_rects - 1] : NULL;
+		if (rect != NULL
+		        && rect->y == (i / gw) * pop->priv->cell_height
+		        && rect->x + rect->width == (i % gw) * pop->priv->cell_width)
+		{
+			rect->width += pop->priv->cell_width;
+		}
+		else
+		{
+			rect = &pop->priv->rects [n_rects++];
+			rect->x = (i % gw) * pop->priv->cell_width;
+			rect->y = (i / gw) * pop->priv->cell_height;
+			rect->width = pop->priv->cell_width;
+			rect->height = pop->priv->cell_height;
+		}
+	}
+
+	cr = cairo_create (pop->priv->surf);
+
+	for (c = 0; c < pop->priv->ncolors; c++)
+	{
+		guint32 rgb = pop->priv->palette [c];
+		guint   j;
+
+		if (start[c] == start[c + 1])
+		{
+			continue;
+		}
+
+		for (j = start[c]; j < start[c + 1]; j++)
+		{
+			int cell = pop->priv->changed [j];
+
+			cairo_rectangle (cr,
+			                 (cell % gw) * pop->priv->cell_width,
+			                 (cell / gw) * pop->priv->cell_height,
+			                 pop->priv->cell_width - border,
+			                 pop->priv->cell_height - border);
+		}
+
+		cairo_set_source_rgb (cr,
+		                      ((rgb >> 16) & 0xff) / 255.0,
+		                      ((rgb >> 8) & 0xff) / 255.0,
+		                      (rgb & 0xff) / 255.0);
+		cairo_fill (cr);
+	}
+
+	cairo_destroy (cr);
+
+	memcpy (pop->priv->drawn, pop->priv->cells, nsquares);
+
+	if (pop->priv->redraw_all || n_changed > (guint) nsquares / 2)
+	{
+		gtk_widget_queue_draw (GTK_WIDGET (pop));
+	}
+	else
+	{
+		cairo_region_t *region;
+
+		region = cairo_region_create_rectangles (pop->priv->rects, n_rects);
+		gtk_widget_queue_draw_region (GTK_WIDGET (pop), region);
+		cairo_region_destroy (region);
+	}
+
+	pop->priv->redraw_all = FALSE;
+}
+
+static void
+draw_frame (GSTEPopsquares *pop,
+            cairo_t        *cr)
+{
+	gs_theme_engine_profile_start (NULL);
+
+	cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_surface (cr, pop->priv->surf, 0, 0);
+	cairo_paint (cr);
+
+	gs_theme_engine_profile_end (NULL);
+}
+
+/* Moves every square n_steps along the color ramp */
+static void
+advance_squares (GSTEPopsquares *pop,
+                 int             n_steps)
+{
+	gboolean twitch = FALSE;
+	int      nsquares;
+	int      i;
 
-	gw = pop->priv->subdivision;
-	gh = pop->priv->subdivision;
-	nsquares = gw * gh;
+	nsquares = pop->priv->grid_size * pop->priv->grid_size;
 
-	for (y = 0; y < gh; y++)
+	for (i = 0; i < nsquares; i++)
 	{
-		for (x = 0; x < gw; x++)
+		int color = pop->priv->cells [i] + n_steps;
+
+		if (color < pop->priv->ncolors)
+		{
+			pop->priv->cells [i] = color;
+			continue;
+		}
+
+		/* past the end of the ramp, start again somewhere */
+		if (twitch && ((g_random_int_range (0, 4)) == 0))
 		{
-			square *s = (square *) &pop->priv->squares [gw * y + x];
-
-			gdk_cairo_set_source_rgba (cr, &(pop->priv->colors [s->color]));
-			cairo_rectangle (cr, s->x, s->y,
-			                 border ? s->w - border : s->w,
-			                 border ? s->h - border : s->h);
-			cairo_fill (cr);
-			s->color++;
-
-			if (s->color == pop->priv->ncolors)
-			{
-				if (twitch && ((g_random_int_range (0, 4)) == 0))
-				{
-					randomize_square_colors (pop->priv->squares, nsquares, pop->priv->ncolors);
-				}
-				else
-				{
-					s->color = g_random_int_range (0, pop->priv->ncolors);
-				}
-			}
+			randomize_square_colors (pop->priv->cells, nsquares, pop->priv->ncolors);
+		}
+		else
+		{
+			pop->priv->cells [i] = g_random_int_range (0, pop->priv->ncolors);
 		}
 	}
 }
 
-static gboolean
-draw_iter (GSTEPopsquares *pop)
+static void
+gste_popsquares_tick (GSThemeEngine *engine,
+                      gint64         frame_time)
 {
-	gtk_widget_queue_draw (GTK_WIDGET (pop));
-	return TRUE;
+	GSTEPopsquares *pop = GSTE_POPSQUARES (engine);
+	int             n_steps;
+
+	if (pop->priv->cells == NULL || pop->priv->palette == NULL)
+	{
+		return;
+	}
+
+	if (pop->priv->last_frame == 0)
+	{
+		pop->priv->last_frame = frame_time;
+		return;
+	}
+
+	/* as many steps as fit in the time since the last frame, the
+	 * rest is carried over */
+	n_steps = (frame_time - pop->priv->last_frame) / COLOR_STEP_TIME;
+	if (n_steps == 0)
+	{
+		return;
+	}
+
+	pop->priv->last_frame += (gint64) n_steps * COLOR_STEP_TIME;
+
+	/* after a long stall, do not spin through the ramp */
+	n_steps = MIN (n_steps, pop->priv->ncolors);
+
+	advance_squares (pop, n_steps);
+	update_surface (pop);
 }
 
 static void
 gste_popsquares_init (GSTEPopsquares *pop)
 {
-	int delay;
-
 	pop->priv = gste_popsquares_get_instance_private (pop);
 
 	pop->priv->ncolors = 128;
-	pop->priv->subdivision = 5;
-
-	delay = 25;
-	pop->priv->timeout_id = g_timeout_add (delay, (GSourceFunc)draw_iter, pop);
+	pop->priv->subdivision = DEFAULT_SUBDIVISION;
 }
 
 static void
@@ -590,13 +836,8 @@ gste_popsquares_finalize (GObject *object)
 
 	g_return_if_fail (pop->priv != NULL);
 
-	if (pop->priv->timeout_id > 0)
-	{
-		g_source_remove (pop->priv->timeout_id);
-		pop->priv->timeout_id = 0;
-	}
-
-	g_free (pop->priv->squares);
+	free_squares (pop);
+	g_free (pop->priv->palette);
 	g_free (pop->priv->colors);
 
 	G_OBJECT_CLASS (parent_class)->finalize (object);
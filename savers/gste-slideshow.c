@@ -26,28 +26,50 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <math.h>
 
 #include <glib.h>
 #include <gtk/gtk.h>
 
 #include "gs-theme-engine.h"
 #include "gste-slideshow.h"
+#include "gste-image-cache.h"
+#include "gste-image-index.h"
 
 static void     gste_slideshow_finalize   (GObject            *object);
 
+#define KB_MAX_LEVELS 4
+
+/* A Ken Burns slide: the image and its halved copies, uploaded once,
+   and the motion it goes through */
+typedef struct
+{
+	cairo_surface_t *levels[KB_MAX_LEVELS];
+	int              level_width[KB_MAX_LEVELS];
+	int              level_height[KB_MAX_LEVELS];
+	int              n_levels;
+	int              width;
+	int              height;
+	double           zoom_from;
+	double           zoom_to;
+	double           x_from;
+	double           y_from;
+	double           x_to;
+	double           y_to;
+	gint64           start;
+} KBSlide;
+
 struct GSTESlideshowPrivate
 {
-	/* Image at full opacity */
-	cairo_pattern_t *pat1;
-	/* Image at partial opacity */
-	cairo_pattern_t *pat2;
-	/* Alpha of pat2 */
+	/* The next image over the background, faded into surf */
+	cairo_surface_t *next_surf;
+	/* Alpha of next_surf */
 	gdouble          alpha2;
-	/* edges of pat2 */
-	int              pat2top;
-	int              pat2bottom;
-	int              pat2left;
-	int              pat2right;
+	/* where the shown and the next image are */
+	cairo_rectangle_int_t cur_rect;
+	cairo_rectangle_int_t next_rect;
+	/* what a fade changes, the rest of surf stays as it is */
+	cairo_region_t  *damage;
 
 	/* backbuffer that we do all the alpha drawing into (no round
 	 * trips to the X server when the server doesn't support drawing
@@ -55,14 +77,48 @@ struct GSTESlideshowPrivate
 	cairo_surface_t *surf;
 
 	gint64           fade_ticks;
-
-	GThread         *load_thread;
-	GAsyncQueue     *op_q;
+	/* opacity the next image is drawn at so far, and the frame time
+	 * the fade is timed from */
+	gdouble          opacity;
+	gint64           fade_start;
+
+	/* decoding happens in a pool of workers, and the images come
+	 * back in the order they were picked in */
+	GThreadPool     *load_pool;
 	GAsyncQueue     *results_q;
+	GMutex           list_lock;
+	guint            pick_seq;
+	guint            next_seq;
+	GList           *pending;
+	GQueue          *ready;
+	int              n_loading;
+	int              prefetch_depth;
+	int              decode_threads;
+	gboolean         want_image;
+
+	/* directories of the index being watched, path -> GFileMonitor */
+	GHashTable      *monitors;
+	guint            monitored_serial;
+	/* changes seen by the monitors, path -> Change, and the ones
+	 * handed to the workers, guarded by list_lock */
+	GHashTable      *changes;
+	GHashTable      *index_changes;
+	guint            changes_id;
+	/* paths removed while images were being decoded; the loads in
+	 * flight may still return them */
+	GHashTable      *removed;
+
+	/* the slideshows of the other monitors show other images */
+	int             monitor_index;
+	int             n_monitors;
+
+	/* images already scaled for this screen by earlier runs */
+	GSTEImageCache  *image_cache;
+	int              cache_size;
 
 	guint           results_pull_id;
 	guint           update_image_id;
-
+	GSTEImageIndex *image_index;
 	GSList         *filename_list;
 	char           *images_location;
 	gboolean        sort_images;
@@ -71,10 +127,28 @@ struct GSTESlideshowPrivate
 	PangoColor     *background_color;
 	gboolean        no_stretch_hint;
 
-	guint           timeout_id;
+	/* frames are drawn from the frame clock ticks, no more often
+	 * than the fade steps or the Ken Burns interval ask for */
+	gint64          last_frame;
 
 	GTimer         *timer;
-	gboolean        fade_disabled;
+	/* fade quality, lowered when frames are too slow and raised
+	 * again once they are fast */
+	int             fade_steps;
+	int             good_fades;
+	gint64          frame_time_total;
+	gint64          frame_time_max;
+
+	/* Ken Burns mode: the shown slide and the one fading in over it */
+	gboolean        ken_burns;
+	int             ken_burns_fps;
+	KBSlide        *kb_cur;
+	KBSlide        *kb_next;
+	/* milliseconds between frames, stretched while they cost more
+	 * than their share of it */
+	int             kb_interval;
+	/* smoothed cost of a frame, in microseconds */
+	double          kb_frame_time;
 };
 
 enum
@@ -83,7 +157,14 @@ enum
     PROP_IMAGES_LOCATION,
     PROP_SORT_IMAGES,
     PROP_SOLID_BACKGROUND,
-    PROP_NO_STRETCH_HINT
+    PROP_NO_STRETCH_HINT,
+    PROP_PREFETCH_DEPTH,
+    PROP_DECODE_THREADS,
+    PROP_CACHE_SIZE,
+    PROP_KEN_BURNS,
+    PROP_KEN_BURNS_FPS,
+    PROP_MONITOR_INDEX,
+    PROP_N_MONITORS
 };
 
 static GObjectClass *parent_class = NULL;
@@ -92,36 +173,169 @@ G_DEFINE_TYPE_WITH_PRIVATE (GSTESlideshow, gste_slideshow, GS_TYPE_THEME_ENGINE)
 
 #define N_FADE_TICKS 10
 #define MINIMUM_FPS 3.0
+#define FRAME_DELAY 25
+#define MIN_FADE_STEPS 2
+/* fast fades needed before trying more steps again */
+#define RECOVER_FADES 3
 #define DEFAULT_IMAGES_LOCATION DATADIR "/pixmaps/backgrounds"
 #define IMAGE_LOAD_TIMEOUT 10000
+#define DEFAULT_PREFETCH_DEPTH 2
+#define DEFAULT_DECODE_THREADS 2
+/* in megabytes */
+#define DEFAULT_CACHE_SIZE 256
+/* changes are batched for this many milliseconds */
+#define CHANGES_DELAY 500
+/* keeps clear of the inotify watch limit */
+#define MAX_MONITORED_DIRS 4096
+#define FADE_DURATION (FRAME_DELAY * N_FADE_TICKS)
+/* how far a Ken Burns slide zooms in, and the most pixels its
+ * largest level may have */
+#define KB_MAX_ZOOM 2.0
+#define KB_MAX_PIXELS (4096.0 * 4096.0)
+/* a slide moves while it is shown and while it fades out, in ms */
+#define KB_DURATION (IMAGE_LOAD_TIMEOUT + FADE_DURATION)
+#define DEFAULT_KEN_BURNS_FPS 25
+#define KB_MIN_FPS 5
+/* share of the time between frames that drawing may take */
+#define KB_CPU_BUDGET 0.5
+/* a frame is drawn when it is due within this much, in microseconds,
+ * rather than waiting for the next display frame */
+#define FRAME_SLACK 4000
+
+static const cairo_user_data_key_t mip_level_key;
+
+typedef enum
+{
+	CHANGE_CREATED = 1,
+	CHANGE_ADDED,
+	CHANGE_REMOVED
+} Change;
 
 typedef struct _Op
 {
 	char          *location;
 	GSTESlideshow *slideshow;
+	int            width;
+	int            height;
+	gboolean       ken_burns;
 } Op;
 
 typedef struct _OpResult
 {
-	GdkPixbuf *pixbuf;
+	/* premultiplied, ready to be uploaded as it is */
+	cairo_surface_t *image;
+	GSTESlideshow   *slideshow;
+	/* position in the slideshow, -1 if no image was picked */
+	gint64           seq;
+	char            *filename;
+	int              width;
+	int              height;
+	gboolean         ken_burns;
 } OpResult;
 
-static gboolean
-push_load_image_func (GSTESlideshow *show)
+static void process_new_image (GSTESlideshow   *show,
+                               cairo_surface_t *image);
+
+static void
+op_result_free (OpResult *result)
+{
+	if (result == NULL)
+	{
+		return;
+	}
+
+	if (result->image != NULL)
+	{
+		cairo_surface_destroy (result->image);
+	}
+
+	if (result->slideshow != NULL)
+	{
+		g_object_unref (result->slideshow);
+	}
+
+	g_free (result->filename);
+	g_free (result);
+}
+
+/* Keeps up to prefetch_depth images decoded or being decoded, so the
+   next slide is ready by the time it is due. */
+static void
+fill_pipeline (GSTESlideshow *show)
 {
-	Op *op;
+	/* the size is not known before the first configure */
+	if (show->priv->window_width <= 0 || show->priv->window_height <= 0)
+	{
+		return;
+	}
 
-	gs_theme_engine_profile_msg ("Starting a new image load");
+	while (show->priv->n_loading + (int) g_queue_get_length (show->priv->ready)
+	        < show->priv->prefetch_depth)
+	{
+		Op *op;
 
-	op = g_new (Op, 1);
+		gs_theme_engine_profile_msg ("Starting a new image load");
 
-	op->location = g_strdup (show->priv->images_location);
-	op->slideshow = g_object_ref (show);
+		op = g_new (Op, 1);
 
-	g_async_queue_push (show->priv->op_q, op);
+		op->location = g_strdup (show->priv->images_location);
+		op->slideshow = g_object_ref (show);
+		op->width = show->priv->window_width;
+		op->height = show->priv->window_height;
+		op->ken_burns = show->priv->ken_burns;
+
+		show->priv->n_loading++;
+		g_thread_pool_push (show->priv->load_pool, op, NULL);
+	}
+}
+
+static cairo_surface_t *
+pop_ready_image (GSTESlideshow *show)
+{
+	OpResult        *result;
+	cairo_surface_t *image;
+
+	image = NULL;
+
+	while (image == NULL
+	        && (result = g_queue_pop_head (show->priv->ready)) != NULL)
+	{
+		/* drop images decoded for a previous window size or mode */
+		if (result->width == show->priv->window_width
+		        && result->height == show->priv->window_height
+		        && result->ken_burns == show->priv->ken_burns)
+		{
+			image = result->image;
+			result->image = NULL;
+		}
+
+		op_result_free (result);
+	}
+
+	return image;
+}
+
+static gboolean
+next_image_func (GSTESlideshow *show)
+{
+	cairo_surface_t *image;
 
 	show->priv->update_image_id = 0;
 
+	image = pop_ready_image (show);
+	if (image != NULL)
+	{
+		process_new_image (show, image);
+		cairo_surface_destroy (image);
+	}
+	else
+	{
+		/* show it as soon as it has been decoded */
+		show->priv->want_image = TRUE;
+	}
+
+	fill_pipeline (show);
+
 	return FALSE;
 }
 
@@ -135,268 +349,920 @@ start_new_load (GSTESlideshow *show,
 	if (show->priv->update_image_id <= 0)
 	{
 		show->priv->update_image_id = g_timeout_add_full (G_PRIORITY_LOW, timeout,
-		                              (GSourceFunc)push_load_image_func,
+		                              (GSourceFunc)next_image_func,
 		                              show, NULL);
 	}
 }
 
 static void
-start_fade (GSTESlideshow *show,
-            GdkPixbuf     *pixbuf)
+set_source_background (GSTESlideshow *show,
+                       cairo_t       *cr)
 {
-	int      pw;
-	int      ph;
-	int      x;
-	int      y;
-	cairo_t *cr;
-	int      window_width;
-	int      window_height;
+	if (show->priv->background_color)
+	{
+		cairo_set_source_rgb (cr, show->priv->background_color->red / 65535.0,
+		                      show->priv->background_color->green / 65535.0,
+		                      show->priv->background_color->blue / 65535.0);
+	}
+	else
+	{
+		cairo_set_source_rgb (cr, 0.0, 0.0, 0.0);
+	}
+}
+
+static void
+start_frames (GSTESlideshow *show)
+{
+	if (! gs_theme_engine_get_ticking (GS_THEME_ENGINE (show)))
+	{
+		show->priv->last_frame = 0;
+		gs_theme_engine_start_ticks (GS_THEME_ENGINE (show));
+	}
+}
+
+static void
+stop_frames (GSTESlideshow *show)
+{
+	gs_theme_engine_stop_ticks (GS_THEME_ENGINE (show));
+}
+
+/* Whether interval microseconds have passed since the last frame */
+static gboolean
+frame_is_due (GSTESlideshow *show,
+              gint64         frame_time,
+              gint64         interval)
+{
+	if (show->priv->last_frame != 0
+	        && frame_time - show->priv->last_frame < interval - FRAME_SLACK)
+	{
+		return FALSE;
+	}
+
+	show->priv->last_frame = frame_time;
+
+	return TRUE;
+}
+
+static void
+clear_fade (GSTESlideshow *show)
+{
+	if (show->priv->next_surf != NULL)
+	{
+		cairo_surface_destroy (show->priv->next_surf);
+		show->priv->next_surf = NULL;
+	}
+
+	if (show->priv->damage != NULL)
+	{
+		cairo_region_destroy (show->priv->damage);
+		show->priv->damage = NULL;
+	}
+}
+
+static KBSlide *
+kb_slide_new (GSTESlideshow   *show,
+              cairo_surface_t *image)
+{
+	cairo_surface_t *level;
+	KBSlide         *slide;
+	double           low;
+	double           high;
+
+	slide = g_new0 (KBSlide, 1);
+
+	/* upload every level once, frames only use the copies */
+	for (level = image;
+	        level != NULL && slide->n_levels < KB_MAX_LEVELS;
+	        level = cairo_surface_get_user_data (level, &mip_level_key))
+	{
+		cairo_surface_t *copy;
+		cairo_t         *cr;
+		int              lw;
+		int              lh;
+
+		lw = cairo_image_surface_get_width (level);
+		lh = cairo_image_surface_get_height (level);
+
+		copy = cairo_surface_create_similar (show->priv->surf,
+		                                     cairo_surface_get_content (level),
+		                                     lw, lh);
+		cr = cairo_create (copy);
+		cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+		cairo_set_source_surface (cr, level, 0, 0);
+		cairo_paint (cr);
+		cairo_destroy (cr);
+
+		slide->levels[slide->n_levels] = copy;
+		slide->level_width[slide->n_levels] = lw;
+		slide->level_height[slide->n_levels] = lh;
+		slide->n_levels++;
+	}
+
+	slide->width = slide->level_width[0];
+	slide->height = slide->level_height[0];
+
+	/* zoom in or out over part of the range, and pan between two
+	 * random spots */
+	low = g_random_double_range (1.0, 1.0 + (KB_MAX_ZOOM - 1.0) / 2.0);
+	high = low + g_random_double_range (0.2, (KB_MAX_ZOOM - 1.0) / 2.0);
+	if (g_random_boolean ())
+	{
+		slide->zoom_from = low;
+		slide->zoom_to = high;
+	}
+	else
+	{
+		slide->zoom_from = high;
+		slide->zoom_to = low;
+	}
+
+	slide->x_from = g_random_double ();
+	slide->y_from = g_random_double ();
+	slide->x_to = g_random_double ();
+	slide->y_to = g_random_double ();
+
+	slide->start = g_get_monotonic_time ();
 
-	gs_theme_engine_profile_start ("start");
+	return slide;
+}
+
+static void
+kb_slide_free (KBSlide *slide)
+{
+	int i;
+
+	if (slide == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < slide->n_levels; i++)
+	{
+		cairo_surface_destroy (slide->levels[i]);
+	}
+
+	g_free (slide);
+}
+
+/* Draws slide as it is at time now, over the background where it does
+   not reach */
+static void
+kb_paint_slide (GSTESlideshow *show,
+                cairo_t       *cr,
+                KBSlide       *slide,
+                gint64         now,
+                double         alpha)
+{
+	double           progress;
+	double           zoom;
+	double           scale;
+	double           dw;
+	double           dh;
+	double           x;
+	double           y;
+	int              window_width;
+	int              window_height;
+	int              n;
 
 	window_width = show->priv->window_width;
 	window_height = show->priv->window_height;
 
-	if (show->priv->pat2 != NULL)
+	progress = CLAMP ((double) (now - slide->start) / (KB_DURATION * 1000.0), 0.0, 1.0);
+	zoom = slide->zoom_from + (slide->zoom_to - slide->zoom_from) * progress;
+
+	/* relative to level 0, which already has the pixels for the
+	 * closest zoom, never magnified past them */
+	scale = MAX ((double) window_width / slide->width,
+	             (double) window_height / slide->height) * zoom;
+	scale = MIN (scale, 1.0);
+
+	dw = slide->width * scale;
+	dh = slide->height * scale;
+
+	x = dw > window_width
+	    ? (window_width - dw) * (slide->x_from + (slide->x_to - slide->x_from) * progress)
+	    : (window_width - dw) / 2;
+	y = dh > window_height
+	    ? (window_height - dh) * (slide->y_from + (slide->y_to - slide->y_from) * progress)
+	    : (window_height - dh) / 2;
+
+	/* the nearest level, so sampling stays within a factor of two */
+	n = CLAMP ((int) floor (-log2 (scale) + 0.5), 0, slide->n_levels - 1);
+
+	cairo_save (cr);
+
+	if (dw < window_width || dh < window_height)
 	{
-		cairo_pattern_destroy (show->priv->pat2);
+		cairo_push_group (cr);
+		set_source_background (show, cr);
+		cairo_paint (cr);
 	}
 
-	pw = gdk_pixbuf_get_width (pixbuf);
-	ph = gdk_pixbuf_get_height (pixbuf);
-	x = (window_width - pw) / 2;
-	y = (window_height - ph) / 2;
+	cairo_translate (cr, x, y);
+	cairo_scale (cr, dw / slide->level_width[n], dh / slide->level_height[n]);
+	cairo_set_source_surface (cr, slide->levels[n], 0, 0);
+	cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_BILINEAR);
+	cairo_pattern_set_extend (cairo_get_source (cr), CAIRO_EXTEND_PAD);
 
-	if (gdk_pixbuf_get_has_alpha (pixbuf) && show->priv->background_color)
+	if (dw < window_width || dh < window_height)
 	{
-		GdkPixbuf *colored;
-		guint32    color;
+		cairo_rectangle (cr, 0, 0, slide->level_width[n], slide->level_height[n]);
+		cairo_fill (cr);
+		cairo_pop_group_to_source (cr);
+	}
+
+	cairo_paint_with_alpha (cr, alpha);
+
+	cairo_restore (cr);
+}
+
+/* Keeps the drawing within its share of the time between frames by
+   spacing the frames out, and brings them back once it is cheaper */
+static void
+kb_adjust_interval (GSTESlideshow *show,
+                    gint64         frame_time)
+{
+	double budget;
+	int    target;
+	int    interval;
+
+	/* smoothed, in microseconds */
+	show->priv->kb_frame_time = (show->priv->kb_frame_time * 7 + frame_time) / 8;
 
-		color = (show->priv->background_color->red << 16)
-		        + (show->priv->background_color->green / 256 << 8)
-		        + show->priv->background_color->blue / 256;
-		colored = gdk_pixbuf_composite_color_simple (pixbuf,
-		          pw, ph,
-		          GDK_INTERP_BILINEAR,
-		          255,
-		          256,
-		          color,
-		          color);
+	target = 1000 / show->priv->ken_burns_fps;
+	budget = show->priv->kb_interval * 1000.0 * KB_CPU_BUDGET;
+	interval = show->priv->kb_interval;
 
-		gdk_pixbuf_copy_area (colored, 0, 0,
-		                      gdk_pixbuf_get_width (colored),
-		                      gdk_pixbuf_get_height (colored),
-		                      pixbuf, 0, 0);
+	if (show->priv->kb_frame_time > budget)
+	{
+		interval = MIN (interval * 5 / 4 + 1, 1000 / KB_MIN_FPS);
+	}
+	else if (show->priv->kb_frame_time < budget / 2 && interval > target)
+	{
+		interval = MAX (interval * 4 / 5, target);
+	}
 
-		g_object_unref(colored);
+	if (interval == show->priv->kb_interval)
+	{
+		return;
 	}
 
+	g_debug ("Ken Burns frame time %.1f ms, drawing every %d ms",
+	         show->priv->kb_frame_time / 1000.0, interval);
+	gs_theme_engine_profile_value ("ken burns frame time (us)", show->priv->kb_frame_time);
+	gs_theme_engine_profile_value ("ken burns interval (ms)", interval);
+
+	show->priv->kb_interval = interval;
+}
+
+static void
+kb_draw_frame (GSTESlideshow *show,
+               gint64         now)
+{
+	cairo_t *cr;
+	gint64   start;
+	double   alpha;
+
+	if (! frame_is_due (show, now, (gint64) show->priv->kb_interval * 1000))
+	{
+		return;
+	}
+
+	start = g_get_monotonic_time ();
+
+	gs_theme_engine_profile_start (NULL);
+
 	cr = cairo_create (show->priv->surf);
 
-	/* XXX Handle out of memory? */
-	gdk_cairo_set_source_pixbuf (cr, pixbuf, x, y);
-	show->priv->pat2 = cairo_pattern_reference (cairo_get_source (cr));
-	show->priv->pat2top = y;
-	show->priv->pat2bottom = y + ph;
-	show->priv->pat2left = x;
-	show->priv->pat2right = x + pw;
+	if (show->priv->kb_cur != NULL)
+	{
+		kb_paint_slide (show, cr, show->priv->kb_cur, now, 1.0);
+	}
+	else
+	{
+		set_source_background (show, cr);
+		cairo_paint (cr);
+	}
+
+	alpha = 0.0;
+	if (show->priv->kb_next != NULL)
+	{
+		alpha = CLAMP ((now - show->priv->kb_next->start) / (FADE_DURATION * 1000.0), 0.0, 1.0);
+		kb_paint_slide (show, cr, show->priv->kb_next, now, alpha);
+	}
 
 	cairo_destroy (cr);
 
+	/* everything moves */
+	gtk_widget_queue_draw (GTK_WIDGET (show));
+
+	gs_theme_engine_profile_end (NULL);
+
+	if (show->priv->kb_next != NULL && alpha >= 1.0)
+	{
+		kb_slide_free (show->priv->kb_cur);
+		show->priv->kb_cur = show->priv->kb_next;
+		show->priv->kb_next = NULL;
+
+		start_new_load (show, IMAGE_LOAD_TIMEOUT);
+	}
+
+	kb_adjust_interval (show, g_get_monotonic_time () - start);
+}
+
+static void
+kb_start_fade (GSTESlideshow   *show,
+               cairo_surface_t *image)
+{
+	kb_slide_free (show->priv->kb_next);
+	show->priv->kb_next = kb_slide_new (show, image);
+
+	start_frames (show);
+}
+
+static void
+kb_clear (GSTESlideshow *show)
+{
+	kb_slide_free (show->priv->kb_cur);
+	kb_slide_free (show->priv->kb_next);
+	show->priv->kb_cur = NULL;
+	show->priv->kb_next = NULL;
+}
+
+static void
+start_fade (GSTESlideshow   *show,
+            cairo_surface_t *image)
+{
+	int      pw;
+	int      ph;
+	cairo_t *cr;
+	int      window_width;
+	int      window_height;
+
+	if (show->priv->ken_burns)
+	{
+		kb_start_fade (show, image);
+		return;
+	}
+
+	gs_theme_engine_profile_start (NULL);
+
+	window_width = show->priv->window_width;
+	window_height = show->priv->window_height;
+
+	clear_fade (show);
+
+	pw = cairo_image_surface_get_width (image);
+	ph = cairo_image_surface_get_height (image);
+
+	show->priv->next_rect.x = (window_width - pw) / 2;
+	show->priv->next_rect.y = (window_height - ph) / 2;
+	show->priv->next_rect.width = pw;
+	show->priv->next_rect.height = ph;
+
+	/* the next frame, composed once: the image over the background */
+	show->priv->next_surf = cairo_surface_create_similar (show->priv->surf,
+	                        CAIRO_CONTENT_COLOR,
+	                        window_width,
+	                        window_height);
+
+	cr = cairo_create (show->priv->next_surf);
+
+	set_source_background (show, cr);
+	cairo_paint (cr);
+
+	/* the only upload of the image, fades only use next_surf */
+	cairo_set_source_surface (cr, image,
+	                          show->priv->next_rect.x,
+	                          show->priv->next_rect.y);
+	cairo_rectangle (cr,
+	                 show->priv->next_rect.x,
+	                 show->priv->next_rect.y,
+	                 pw, ph);
+	cairo_fill (cr);
+
+	cairo_destroy (cr);
+
+	/* outside of both images the background stays as it is */
+	show->priv->damage = cairo_region_create_rectangle (&show->priv->cur_rect);
+	cairo_region_union_rectangle (show->priv->damage, &show->priv->next_rect);
+
 	show->priv->fade_ticks = 0;
+	show->priv->opacity = 0.0;
+	show->priv->fade_start = 0;
 	g_timer_start (show->priv->timer);
 
-	gs_theme_engine_profile_end ("end");
+	show->priv->frame_time_total = 0;
+	show->priv->frame_time_max = 0;
+
+	/* frames only run during fades */
+	start_frames (show);
+
+	gs_theme_engine_profile_end (NULL);
 }
 
 static void
 finish_fade (GSTESlideshow *show)
 {
-	gs_theme_engine_profile_start ("start");
+	gs_theme_engine_profile_start (NULL);
 
-	if (show->priv->pat1 != NULL)
-	{
-		cairo_pattern_destroy (show->priv->pat1);
-	}
+	show->priv->cur_rect = show->priv->next_rect;
+	clear_fade (show);
 
-	show->priv->pat1 = show->priv->pat2;
-	show->priv->pat2 = NULL;
+	stop_frames (show);
 
 	start_new_load (show, IMAGE_LOAD_TIMEOUT);
 
-	gs_theme_engine_profile_end ("end");
+	gs_theme_engine_profile_end (NULL);
 }
 
 static void
 update_display (GSTESlideshow *show)
 {
-	int      window_width;
-	int      window_height;
 	cairo_t *cr;
 
-	gs_theme_engine_profile_start ("start");
+	gs_theme_engine_profile_start (NULL);
 
 	cr = cairo_create (show->priv->surf);
 
-	gs_theme_engine_get_window_size (GS_THEME_ENGINE (show),
-	                                 &window_width,
-	                                 &window_height);
+	gdk_cairo_region (cr, show->priv->damage);
+	cairo_clip (cr);
+
+	gs_theme_engine_profile_start ("paint pattern to surface");
+	cairo_set_source_surface (cr, show->priv->next_surf, 0, 0);
+	cairo_paint_with_alpha (cr, show->priv->alpha2);
+	gs_theme_engine_profile_end ("paint pattern to surface");
+
+	cairo_destroy (cr);
+
+	gtk_widget_queue_draw_region (GTK_WIDGET (show), show->priv->damage);
+
+	gs_theme_engine_profile_end (NULL);
+}
 
-	if (show->priv->pat2 != NULL)
+/* Picks the number of steps of the next fade from how this one went */
+static void
+adjust_fade_quality (GSTESlideshow *show)
+{
+	gdouble elapsed;
+	gdouble fps;
+	gdouble frame_avg;
+	gdouble frame_max;
+	int     frame_delay;
+
+	elapsed = g_timer_elapsed (show->priv->timer, NULL);
+	fps = (gdouble) show->priv->fade_ticks / elapsed;
+	frame_avg = (gdouble) show->priv->frame_time_total / show->priv->fade_ticks / 1000.0;
+	frame_max = (gdouble) show->priv->frame_time_max / 1000.0;
+	frame_delay = FRAME_DELAY * N_FADE_TICKS / show->priv->fade_steps;
+
+	g_debug ("Fade in %d steps: %.1f fps, frame time %.1f ms average, %.1f ms max",
+	         show->priv->fade_steps, fps, frame_avg, frame_max);
+	gs_theme_engine_profile_value ("fade steps", show->priv->fade_steps);
+	gs_theme_engine_profile_value ("fade fps", (gint64) fps);
+	gs_theme_engine_profile_value ("fade frame time avg (us)",
+	                               show->priv->frame_time_total / show->priv->fade_ticks);
+	gs_theme_engine_profile_value ("fade frame time max (us)", show->priv->frame_time_max);
+
+	if (fps < MINIMUM_FPS || frame_avg > frame_delay)
 	{
-		/* fade out areas not covered by the new image */
-		/* top */
-		cairo_rectangle (cr, 0, 0, window_width, show->priv->pat2top);
-		if (show->priv->background_color)
-		{
-			cairo_set_source_rgba (cr, show->priv->background_color->red / 65535.0,
-			                       show->priv->background_color->green / 65535.0,
-			                       show->priv->background_color->blue / 65535.0, show->priv->alpha2);
-		}
-		else
+		/* fewer, longer steps */
+		show->priv->fade_steps = MAX (show->priv->fade_steps / 2, MIN_FADE_STEPS);
+		show->priv->good_fades = 0;
+	}
+	else if (frame_max < frame_delay / 4.0)
+	{
+		show->priv->good_fades++;
+
+		/* the machine has time again */
+		if (show->priv->good_fades >= RECOVER_FADES
+		        && show->priv->fade_steps < N_FADE_TICKS)
 		{
-			cairo_set_source_rgba (cr, 0.0, 0.0, 0.0, show->priv->alpha2);
+			show->priv->fade_steps = MIN (show->priv->fade_steps * 2, N_FADE_TICKS);
+			show->priv->good_fades = 0;
 		}
-		cairo_fill (cr);
-		/* left (excluding what's covered by top and bottom) */
-		cairo_rectangle (cr, 0, show->priv->pat2top,
-		                 show->priv->pat2left,
-		                 show->priv->pat2bottom - show->priv->pat2top);
-		if (show->priv->background_color)
+	}
+	else
+	{
+		show->priv->good_fades = 0;
+	}
+}
+
+/* Draws the next step of a fade. With fewer steps each one lasts
+   longer; the opacity follows the frame time, so a fade always takes
+   the same time. */
+static void
+fade_draw_frame (GSTESlideshow *show,
+                 gint64         frame_time)
+{
+	gint64 step_time;
+	gint64 start;
+	gint64 draw_time;
+	double new_opacity;
+
+	step_time = (gint64) FADE_DURATION * 1000 / show->priv->fade_steps;
+
+	if (! frame_is_due (show, frame_time, step_time))
+	{
+		return;
+	}
+
+	/* the first frame shows the first step */
+	if (show->priv->fade_start == 0)
+	{
+		show->priv->fade_start = frame_time - step_time;
+	}
+
+	show->priv->fade_ticks++;
+
+	/*
+	 * We have currently drawn the next frame with opacity, and we
+	 * want to set alpha2 so that drawing it at alpha2 yields it
+	 * drawn with new_opacity
+	 *
+	 * Solving
+	 *   new_opacity = 1 - (1 - alpha2) * (1 - opacity)
+	 * yields
+	 *   alpha2 = 1 - (1 - new_opacity) / (1 - opacity)
+	 *
+	 * XXX This assumes that cairo doesn't correct alpha for
+	 * the color profile.  However, any error is guaranteed
+	 * to be cleaned up by the last iteration, where alpha2
+	 * becomes 1 because new_opacity is 1.
+	 */
+	new_opacity = MIN ((double) (frame_time - show->priv->fade_start)
+	                   / (FADE_DURATION * 1000.0), 1.0);
+	show->priv->alpha2 = 1.0 - (1.0 - new_opacity) /
+	                     (1.0 - show->priv->opacity);
+	show->priv->opacity = new_opacity;
+
+	start = g_get_monotonic_time ();
+	update_display (show);
+	draw_time = g_get_monotonic_time () - start;
+
+	show->priv->frame_time_total += draw_time;
+	show->priv->frame_time_max = MAX (show->priv->frame_time_max, draw_time);
+
+	if (new_opacity >= 1.0)
+	{
+		adjust_fade_quality (show);
+		finish_fade (show);
+	}
+}
+
+static void
+gste_slideshow_tick (GSThemeEngine *engine,
+                     gint64         frame_time)
+{
+	GSTESlideshow *show = GSTE_SLIDESHOW (engine);
+
+	if (show->priv->ken_burns)
+	{
+		kb_draw_frame (show, frame_time);
+	}
+	else if (show->priv->next_surf != NULL)
+	{
+		fade_draw_frame (show, frame_time);
+	}
+	else
+	{
+		stop_frames (show);
+	}
+}
+
+static gboolean
+path_is_below (const char *path,
+               const char *dir)
+{
+	gsize len;
+
+	len = strlen (dir);
+
+	return strncmp (path, dir, len) == 0
+	       && (path[len] == G_DIR_SEPARATOR || path[len] == '\0');
+}
+
+/* Called by the workers with list_lock held, before picking an image */
+static void
+apply_index_changes (GSTESlideshow *show)
+{
+	GHashTableIter iter;
+	gpointer       path;
+	gpointer       change;
+
+	if (show->priv->index_changes == NULL)
+	{
+		return;
+	}
+
+	g_hash_table_iter_init (&iter, show->priv->index_changes);
+	while (g_hash_table_iter_next (&iter, &path, &change))
+	{
+		switch (GPOINTER_TO_INT (change))
 		{
-			cairo_set_source_rgba (cr, show->priv->background_color->red / 65535.0,
-			                       show->priv->background_color->green / 65535.0,
-			                       show->priv->background_color->blue / 65535.0, show->priv->alpha2);
+		case CHANGE_REMOVED:
+			gste_image_index_remove (show->priv->image_index, path);
+			break;
+		case CHANGE_ADDED:
+			if (g_file_test (path, G_FILE_TEST_IS_DIR))
+			{
+				gste_image_index_add_dir (show->priv->image_index, path);
+			}
+			else if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+			{
+				gste_image_index_add_file (show->priv->image_index, path);
+			}
+			break;
+		case CHANGE_CREATED:
+			/* files are added once they have been written */
+			if (g_file_test (path, G_FILE_TEST_IS_DIR))
+			{
+				gste_image_index_add_dir (show->priv->image_index, path);
+			}
+			break;
+		default:
+			break;
 		}
-		else
+	}
+
+	g_hash_table_destroy (show->priv->index_changes);
+	show->priv->index_changes = NULL;
+}
+
+static gboolean
+result_is_removed (GSTESlideshow *show,
+                   OpResult      *result)
+{
+	GHashTableIter iter;
+	gpointer       path;
+
+	if (result->filename == NULL)
+	{
+		return FALSE;
+	}
+
+	g_hash_table_iter_init (&iter, show->priv->removed);
+	while (g_hash_table_iter_next (&iter, &path, NULL))
+	{
+		if (path_is_below (result->filename, path))
 		{
-			cairo_set_source_rgba (cr, 0.0, 0.0, 0.0, show->priv->alpha2);
+			return TRUE;
 		}
-		cairo_fill (cr);
-		/* bottom */
-		cairo_rectangle (cr, 0, show->priv->pat2bottom, window_width,
-		                 window_height - show->priv->pat2bottom);
-		if (show->priv->background_color)
+	}
+
+	return FALSE;
+}
+
+/* Drops decoded images of files that went away, and remembers them
+   for the images still being decoded */
+static void
+drop_removed_results (GSTESlideshow *show,
+                      GHashTable    *changes)
+{
+	GHashTableIter iter;
+	gpointer       path;
+	gpointer       change;
+	GList         *l;
+	GList         *next;
+
+	g_hash_table_iter_init (&iter, changes);
+	while (g_hash_table_iter_next (&iter, &path, &change))
+	{
+		if (GPOINTER_TO_INT (change) == CHANGE_REMOVED)
 		{
-			cairo_set_source_rgba (cr, show->priv->background_color->red / 65535.0,
-			                       show->priv->background_color->green / 65535.0,
-			                       show->priv->background_color->blue / 65535.0, show->priv->alpha2);
+			g_hash_table_add (show->priv->removed, g_strdup (path));
 		}
 		else
 		{
-			cairo_set_source_rgba (cr, 0.0, 0.0, 0.0, show->priv->alpha2);
+			g_hash_table_remove (show->priv->removed, path);
 		}
-		cairo_fill (cr);
-		/* right (excluding what's covered by top and bottom) */
-		cairo_rectangle (cr, show->priv->pat2right,
-		                 show->priv->pat2top,
-		                 window_width - show->priv->pat2right,
-		                 show->priv->pat2bottom - show->priv->pat2top);
-		if (show->priv->background_color)
+	}
+
+	if (g_hash_table_size (show->priv->removed) == 0)
+	{
+		return;
+	}
+
+	for (l = show->priv->ready->head; l != NULL; l = next)
+	{
+		OpResult *result = l->data;
+
+		next = l->next;
+
+		if (result_is_removed (show, result))
 		{
-			cairo_set_source_rgba (cr, show->priv->background_color->red / 65535.0,
-			                       show->priv->background_color->green / 65535.0,
-			                       show->priv->background_color->blue / 65535.0, show->priv->alpha2);
+			g_queue_delete_link (show->priv->ready, l);
+			op_result_free (result);
 		}
-		else
+	}
+
+	/* the pending results keep their place in the sequence, they
+	 * are dropped once their turn comes */
+	for (l = show->priv->pending; l != NULL; l = l->next)
+	{
+		OpResult *result = l->data;
+
+		if (result->image != NULL && result_is_removed (show, result))
 		{
-			cairo_set_source_rgba (cr, 0.0, 0.0, 0.0, show->priv->alpha2);
+			cairo_surface_destroy (result->image);
+			result->image = NULL;
 		}
-		cairo_fill (cr);
+	}
 
-		gs_theme_engine_profile_start ("paint pattern to surface");
-		cairo_set_source (cr, show->priv->pat2);
+	/* later loads pick from the updated index */
+	if (show->priv->n_loading == 0)
+	{
+		g_hash_table_remove_all (show->priv->removed);
+	}
+}
 
-		cairo_paint_with_alpha (cr, show->priv->alpha2);
-		gs_theme_engine_profile_end ("paint pattern to surface");
+static gboolean
+changes_timeout (GSTESlideshow *show)
+{
+	GHashTableIter iter;
+	gpointer       path;
+	gpointer       change;
+
+	/* a worker may be scanning, try again later rather than wait */
+	if (! g_mutex_trylock (&show->priv->list_lock))
+	{
+		return TRUE;
 	}
-	else
+
+	if (show->priv->index_changes == NULL)
+	{
+		show->priv->index_changes = g_hash_table_new_full (g_str_hash,
+		                                                   g_str_equal,
+		                                                   g_free,
+		                                                   NULL);
+	}
+
+	g_hash_table_iter_init (&iter, show->priv->changes);
+	while (g_hash_table_iter_next (&iter, &path, &change))
+	{
+		g_hash_table_replace (show->priv->index_changes, g_strdup (path), change);
+	}
+
+	g_mutex_unlock (&show->priv->list_lock);
+
+	drop_removed_results (show, show->priv->changes);
+	g_hash_table_remove_all (show->priv->changes);
+
+	show->priv->changes_id = 0;
+
+	/* replace what was dropped */
+	fill_pipeline (show);
+
+	return FALSE;
+}
+
+static void
+queue_change (GSTESlideshow *show,
+              GFile         *file,
+              Change         change)
+{
+	char *path;
+
+	path = g_file_get_path (file);
+	if (path == NULL)
+	{
+		return;
+	}
+
+	/* the last change to a path wins */
+	g_hash_table_replace (show->priv->changes, path, GINT_TO_POINTER (change));
+
+	/* a burst of changes is handled at once */
+	if (show->priv->changes_id == 0)
+	{
+		show->priv->changes_id = g_timeout_add (CHANGES_DELAY,
+		                                        (GSourceFunc)changes_timeout,
+		                                        show);
+	}
+}
+
+static void
+monitor_changed_cb (GFileMonitor      *monitor,
+                    GFile             *file,
+                    GFile             *other_file,
+                    GFileMonitorEvent  event_type,
+                    GSTESlideshow     *show)
+{
+	switch (event_type)
 	{
-		if (show->priv->pat1 != NULL)
+	case G_FILE_MONITOR_EVENT_CREATED:
+		queue_change (show, file, CHANGE_CREATED);
+		break;
+	case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+	case G_FILE_MONITOR_EVENT_MOVED_IN:
+		queue_change (show, file, CHANGE_ADDED);
+		break;
+	case G_FILE_MONITOR_EVENT_DELETED:
+	case G_FILE_MONITOR_EVENT_MOVED_OUT:
+		queue_change (show, file, CHANGE_REMOVED);
+		break;
+	case G_FILE_MONITOR_EVENT_RENAMED:
+		queue_change (show, file, CHANGE_REMOVED);
+		if (other_file != NULL)
 		{
-			cairo_set_source (cr, show->priv->pat1);
-			cairo_paint (cr);
+			queue_change (show, other_file, CHANGE_ADDED);
 		}
+		break;
+	default:
+		break;
 	}
+}
 
-	cairo_destroy (cr);
-
-	gtk_widget_queue_draw (GTK_WIDGET (show));
+static void
+monitor_free (GFileMonitor *monitor)
+{
+	g_signal_handlers_disconnect_matched (monitor, G_SIGNAL_MATCH_FUNC,
+	                                      0, 0, NULL, monitor_changed_cb, NULL);
+	g_file_monitor_cancel (monitor);
+	g_object_unref (monitor);
 }
 
-static gboolean
-draw_iter (GSTESlideshow *show)
+/* Watches the directories the index knows about */
+static void
+sync_monitors (GSTESlideshow *show)
 {
-	double old_opacity;
-	double new_opacity;
+	GHashTableIter iter;
+	GHashTable    *wanted;
+	GPtrArray     *dirs;
+	gpointer       path;
+	guint          i;
+
+	/* do not wait for a worker that is scanning */
+	if (! g_mutex_trylock (&show->priv->list_lock))
+	{
+		return;
+	}
+
+	if (show->priv->image_index == NULL
+	        || gste_image_index_get_serial (show->priv->image_index) == show->priv->monitored_serial)
+	{
+		g_mutex_unlock (&show->priv->list_lock);
+		return;
+	}
+
+	dirs = gste_image_index_get_dirs (show->priv->image_index);
+	show->priv->monitored_serial = gste_image_index_get_serial (show->priv->image_index);
 
-	if (show->priv->pat2 != NULL)
+	g_mutex_unlock (&show->priv->list_lock);
+
+	wanted = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; i < dirs->len && i < MAX_MONITORED_DIRS; i++)
 	{
-		gdouble fps;
-		gdouble elapsed;
+		g_hash_table_add (wanted, g_ptr_array_index (dirs, i));
+	}
 
-		if (show->priv->fade_disabled)
+	g_hash_table_iter_init (&iter, show->priv->monitors);
+	while (g_hash_table_iter_next (&iter, &path, NULL))
+	{
+		if (! g_hash_table_contains (wanted, path))
 		{
-			show->priv->alpha2 = 1.0;
-			update_display (show);
-			finish_fade (show);
-			return TRUE;
+			g_hash_table_iter_remove (&iter);
 		}
+	}
+
+	g_hash_table_iter_init (&iter, wanted);
+	while (g_hash_table_iter_next (&iter, &path, NULL))
+	{
+		GFileMonitor *monitor;
+		GFile        *file;
 
-		/* we are in a fade */
-		show->priv->fade_ticks++;
-
-		/*
-		 * We have currently drawn pat2 with old_opacity, and we
-		 * want to set alpha2 so that drawing pat2 at alpha2
-		 * yields it drawn with new_opacity
-		 *
-		 * Solving
-		 *   new_opacity = 1 - (1 - alpha2) * (1 - old_opacity)
-		 * yields
-		 *   alpha2 = 1 - (1 - new_opacity) / (1 - old_opacity)
-		 *
-		 * XXX This assumes that cairo doesn't correct alpha for
-		 * the color profile.  However, any error is guaranteed
-		 * to be cleaned up by the last iteration, where alpha2
-		 * becomes 1 because new_opacity is 1.
-		 */
-		old_opacity = (double) (show->priv->fade_ticks - 1) /
-		              (double) N_FADE_TICKS;
-		new_opacity = (double) show->priv->fade_ticks /
-		              (double) N_FADE_TICKS;
-		show->priv->alpha2 = 1.0 - (1.0 - new_opacity) /
-		                     (1.0 - old_opacity);
-
-		update_display (show);
-
-		elapsed = g_timer_elapsed (show->priv->timer, NULL);
-		fps = (gdouble)show->priv->fade_ticks / elapsed;
-		if (fps < MINIMUM_FPS)
+		if (g_hash_table_contains (show->priv->monitors, path))
 		{
-			g_warning ("Getting less than %.2f frames per second, disabling fade", MINIMUM_FPS);
-			show->priv->fade_ticks = N_FADE_TICKS - 1;
-			show->priv->fade_disabled = TRUE;
+			continue;
 		}
 
-		if (show->priv->fade_ticks >= N_FADE_TICKS)
+		file = g_file_new_for_path (path);
+		monitor = g_file_monitor_directory (file, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+		g_object_unref (file);
+
+		if (monitor == NULL)
 		{
-			finish_fade (show);
+			continue;
 		}
+
+		g_signal_connect (monitor, "changed",
+		                  G_CALLBACK (monitor_changed_cb), show);
+		g_hash_table_insert (show->priv->monitors, g_strdup (path), monitor);
 	}
 
-	return TRUE;
+	g_hash_table_destroy (wanted);
+	g_ptr_array_unref (dirs);
 }
 
 static void
-process_new_pixbuf (GSTESlideshow *show,
-                    GdkPixbuf     *pixbuf)
+process_new_image (GSTESlideshow   *show,
+                   cairo_surface_t *image)
 {
 	gs_theme_engine_profile_msg ("Processing a new image");
 
-	if (pixbuf != NULL)
+	if (image != NULL)
 	{
-		start_fade (show, pixbuf);
+		start_fade (show, image);
 	}
 	else
 	{
@@ -404,220 +1270,613 @@ process_new_pixbuf (GSTESlideshow *show,
 	}
 }
 
+static int
+op_result_compare_seq (gconstpointer a,
+                       gconstpointer b)
+{
+	const OpResult *result_a = a;
+	const OpResult *result_b = b;
+
+	return (result_a->seq > result_b->seq) - (result_a->seq < result_b->seq);
+}
+
+/* Moves the results that are next in line to the ready queue */
 static void
-op_result_free (OpResult *result)
+add_result (GSTESlideshow *show,
+            OpResult      *result)
 {
-	if (result == NULL)
+	show->priv->n_loading--;
+
+	/* the caller holds a reference, queued images must not keep
+	 * the slideshow alive */
+	g_object_unref (result->slideshow);
+	result->slideshow = NULL;
+
+	if (result->seq < 0)
 	{
+		op_result_free (result);
 		return;
 	}
 
-	if (result->pixbuf != NULL)
+	/* the file went away while it was being decoded */
+	if (result->image != NULL && result_is_removed (show, result))
 	{
-		g_object_unref (result->pixbuf);
+		cairo_surface_destroy (result->image);
+		result->image = NULL;
 	}
 
-	g_free (result);
+	if (show->priv->n_loading == 0)
+	{
+		g_hash_table_remove_all (show->priv->removed);
+	}
+
+	show->priv->pending = g_list_insert_sorted (show->priv->pending, result,
+	                                            op_result_compare_seq);
+
+	while (show->priv->pending != NULL)
+	{
+		result = show->priv->pending->data;
+		if (result->seq != show->priv->next_seq)
+		{
+			break;
+		}
+
+		show->priv->pending = g_list_delete_link (show->priv->pending,
+		                                          show->priv->pending);
+		show->priv->next_seq++;
+
+		if (result->image != NULL)
+		{
+			g_queue_push_tail (show->priv->ready, result);
+		}
+		else
+		{
+			op_result_free (result);
+		}
+	}
 }
 
 static gboolean
 results_pull_func (GSTESlideshow *show)
 {
 	OpResult *result;
+	GSList   *results;
+	GSList   *l;
 
 	g_async_queue_lock (show->priv->results_q);
 
+	results = NULL;
 	result = g_async_queue_try_pop_unlocked (show->priv->results_q);
 	g_assert (result);
 
-	while (result != NULL)
+	while (result != NULL)
+	{
+		results = g_slist_prepend (results, result);
+		result = g_async_queue_try_pop_unlocked (show->priv->results_q);
+	}
+
+	show->priv->results_pull_id = 0;
+
+	g_async_queue_unlock (show->priv->results_q);
+
+	/* the results keep the slideshow alive until they are handled */
+	g_object_ref (show);
+
+	results = g_slist_reverse (results);
+	for (l = results; l != NULL; l = l->next)
+	{
+		add_result (show, l->data);
+	}
+	g_slist_free (results);
+
+	if (show->priv->want_image)
+	{
+		cairo_surface_t *image;
+
+		image = pop_ready_image (show);
+		if (image != NULL)
+		{
+			show->priv->want_image = FALSE;
+			process_new_image (show, image);
+			cairo_surface_destroy (image);
+		}
+		else if (show->priv->n_loading == 0)
+		{
+			/* nothing loadable came back, try again shortly */
+			show->priv->want_image = FALSE;
+			process_new_image (show, NULL);
+		}
+	}
+
+	fill_pipeline (show);
+
+	/* the index may have found new directories */
+	sync_monitors (show);
+
+	g_object_unref (show);
+
+	return FALSE;
+}
+
+/* size a pw x ph image has to be scaled to so that it fits max_width x
+   max_height, or covers it: always scale down, allow to disable scaling
+   up */
+static float
+get_scale_factor (int      pw,
+                  int      ph,
+                  int      max_width,
+                  int      max_height,
+                  gboolean no_stretch_hint,
+                  gboolean cover)
+{
+	float      scale_factor_x = 1.0;
+	float      scale_factor_y = 1.0;
+	float      scale_factor = 1.0;
+
+	/* Determine which dimension requires the smallest scale. */
+	scale_factor_x = (float) max_width / (float) pw;
+	scale_factor_y = (float) max_height / (float) ph;
+
+	if ((scale_factor_x > scale_factor_y) != cover)
+	{
+		scale_factor = scale_factor_y;
+	}
+	else
+	{
+		scale_factor = scale_factor_x;
+	}
+
+	if (scale_factor < 1.0 || !no_stretch_hint)
+	{
+		return scale_factor;
+	}
+
+	return 1.0;
+}
+
+static gboolean
+orientation_is_transposed (int orientation)
+{
+	/* EXIF orientations 5 to 8 swap width and height */
+	return (orientation >= 5 && orientation <= 8);
+}
+
+/* Scales and orients an image that was decoded near its final size */
+static GdkPixbuf *
+scale_pixbuf (GdkPixbuf *pixbuf,
+              int        max_width,
+              int        max_height,
+              gboolean   no_stretch_hint,
+              gboolean   cover)
+{
+	const char *option;
+	int         orientation;
+	int         pw;
+	int         ph;
+	int         scale_x;
+	int         scale_y;
+	float       scale_factor;
+	GdkPixbuf  *scaled;
+	GdkPixbuf  *oriented;
+
+	pw = gdk_pixbuf_get_width (pixbuf);
+	ph = gdk_pixbuf_get_height (pixbuf);
+
+	option = gdk_pixbuf_get_option (pixbuf, "orientation");
+	orientation = option != NULL ? atoi (option) : 1;
+
+	/* fit the image as it will be once rotated */
+	if (orientation_is_transposed (orientation))
+	{
+		scale_factor = get_scale_factor (pw, ph, max_height, max_width, no_stretch_hint, cover);
+	}
+	else
+	{
+		scale_factor = get_scale_factor (pw, ph, max_width, max_height, no_stretch_hint, cover);
+	}
+
+	scale_x = (int) (pw * scale_factor);
+	scale_y = (int) (ph * scale_factor);
+
+	if (scale_x == pw && scale_y == ph)
+	{
+		scaled = g_object_ref (pixbuf);
+	}
+	else
+	{
+		scaled = gdk_pixbuf_scale_simple (pixbuf,
+		                                  scale_x,
+		                                  scale_y,
+		                                  GDK_INTERP_BILINEAR);
+		if (scaled != NULL && option != NULL)
+		{
+			gdk_pixbuf_set_option (scaled, "orientation", option);
+		}
+	}
+
+	if (scaled == NULL || orientation == 1)
 	{
-		process_new_pixbuf (show, result->pixbuf);
-		op_result_free (result);
-
-		result = g_async_queue_try_pop_unlocked (show->priv->results_q);
+		return scaled;
 	}
 
-	show->priv->results_pull_id = 0;
-
-	g_async_queue_unlock (show->priv->results_q);
+	/* rotate the small copy, never the decoded image */
+	oriented = gdk_pixbuf_apply_embedded_orientation (scaled);
+	g_object_unref (scaled);
 
-	return FALSE;
+	return oriented;
 }
 
-static GdkPixbuf *
-scale_pixbuf (GdkPixbuf *pixbuf,
-              int        max_width,
-              int        max_height,
-              gboolean   no_stretch_hint)
+typedef struct
 {
-	int        pw;
-	int        ph;
-	float      scale_factor_x = 1.0;
-	float      scale_factor_y = 1.0;
-	float      scale_factor = 1.0;
+	int      max_width;
+	int      max_height;
+	gboolean cover;
 
-	pw = gdk_pixbuf_get_width (pixbuf);
-	ph = gdk_pixbuf_get_height (pixbuf);
+	/* size of the image in the file */
+	int      width;
+	int      height;
+} LoadSize;
+
+static void
+loader_size_prepared_cb (GdkPixbufLoader *loader,
+                         int              width,
+                         int              height,
+                         LoadSize        *size)
+{
+	float scale_factor;
+	float transposed_factor;
+
+	size->width = width;
+	size->height = height;
 
 	/* If the image is less than 256 wide or high then it
-	   is probably a thumbnail and we should ignore it */
-	if (pw < 256 || ph < 256)
+	   is probably a thumbnail and we will ignore it */
+	if (width < 256 || height < 256)
 	{
-		return NULL;
+		return;
 	}
 
-	/* Determine which dimension requires the smallest scale. */
-	scale_factor_x = (float) max_width / (float) pw;
-	scale_factor_y = (float) max_height / (float) ph;
-
-	if (scale_factor_x > scale_factor_y)
+	/* the orientation is only known once the image is decoded, so
+	   decode large enough for either way around */
+	scale_factor = get_scale_factor (width, height,
+	                                 size->max_width, size->max_height,
+	                                 TRUE, size->cover);
+	transposed_factor = get_scale_factor (width, height,
+	                                      size->max_height, size->max_width,
+	                                      TRUE, size->cover);
+	scale_factor = MAX (scale_factor, transposed_factor);
+
+	/* the loader only ever scales down, JPEG does it while decoding */
+	if (scale_factor < 1.0)
 	{
-		scale_factor = scale_factor_y;
+		gdk_pixbuf_loader_set_size (loader,
+		                            MAX (1, (int) (width * scale_factor + 0.5)),
+		                            MAX (1, (int) (height * scale_factor + 0.5)));
 	}
-	else
+}
+
+#define LOAD_CHUNK_SIZE (64 * 1024)
+
+/* Decodes filename directly at about the size it will be shown at,
+   instead of decoding the full image and scaling it afterwards.  The
+   file is read rather than mapped, photos may be rewritten or
+   truncated while they are being decoded. */
+static GdkPixbuf *
+load_pixbuf_at_size (const char *filename,
+                     int         max_width,
+                     int         max_height,
+                     gboolean    no_stretch_hint,
+                     gboolean    cover)
+{
+	GFile            *file;
+	GFileInputStream *stream;
+	GdkPixbufLoader  *loader;
+	GdkPixbuf        *pixbuf;
+	GdkPixbuf        *scaled;
+	LoadSize          size;
+	guchar           *buffer;
+	gssize            n_read;
+	gboolean          ok;
+
+	file = g_file_new_for_path (filename);
+	stream = g_file_read (file, NULL, NULL);
+	g_object_unref (file);
+	if (stream == NULL)
 	{
-		scale_factor = scale_factor_x;
+		return NULL;
 	}
 
-	/* always scale down, allow to disable scaling up */
-	if (scale_factor < 1.0 || !no_stretch_hint)
+	size.max_width = max_width;
+	size.max_height = max_height;
+	size.cover = cover;
+	size.width = 0;
+	size.height = 0;
+
+	loader = gdk_pixbuf_loader_new ();
+	g_signal_connect (loader, "size-prepared",
+	                  G_CALLBACK (loader_size_prepared_cb), &size);
+
+	buffer = g_malloc (LOAD_CHUNK_SIZE);
+
+	ok = TRUE;
+	while (ok)
 	{
-		int scale_x;
-		int scale_y;
+		n_read = g_input_stream_read (G_INPUT_STREAM (stream), buffer,
+		                              LOAD_CHUNK_SIZE, NULL, NULL);
+		if (n_read <= 0)
+		{
+			ok = (n_read == 0);
+			break;
+		}
+
+		ok = gdk_pixbuf_loader_write (loader, buffer, n_read, NULL);
 
-		scale_x = (int) (pw * scale_factor);
-		scale_y = (int) (ph * scale_factor);
-		return gdk_pixbuf_scale_simple (pixbuf,
-		                                scale_x,
-		                                scale_y,
-		                                GDK_INTERP_BILINEAR);
+		/* stop reading thumbnails as soon as we know */
+		if (size.width > 0 && (size.width < 256 || size.height < 256))
+		{
+			ok = FALSE;
+		}
 	}
-	else
+
+	/* always close, the loader complains otherwise */
+	ok = gdk_pixbuf_loader_close (loader, NULL) && ok;
+
+	scaled = NULL;
+	pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+	if (ok && pixbuf != NULL)
 	{
-		return g_object_ref (pixbuf);
+		scaled = scale_pixbuf (pixbuf, max_width, max_height, no_stretch_hint, cover);
 	}
+
+	g_object_unref (loader);
+	g_object_unref (stream);
+	g_free (buffer);
+
+	return scaled;
 }
 
-static void
-add_files_to_list (GSList    **list,
-                   const char *base)
-{
-	GDir       *d;
-	const char *d_name;
+/* c * a / 255, rounded, without a division */
+#define PREMULTIPLY(c, a) ((((c) * (a) + 0x80) + (((c) * (a) + 0x80) >> 8)) >> 8)
 
-	d = g_dir_open (base, 0, NULL);
-	if (d == NULL)
+/* Converts to cairo's premultiplied layout here in the worker, so the
+   main thread only has to upload the result. */
+static cairo_surface_t *
+surface_from_pixbuf (GdkPixbuf *pixbuf)
+{
+	cairo_surface_t *surface;
+	cairo_format_t   format;
+	const guchar    *src_row;
+	guchar          *dst_row;
+	int              width;
+	int              height;
+	int              n_channels;
+	int              src_stride;
+	int              dst_stride;
+	int              x;
+	int              y;
+
+	width = gdk_pixbuf_get_width (pixbuf);
+	height = gdk_pixbuf_get_height (pixbuf);
+	n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+	format = n_channels == 3 ? CAIRO_FORMAT_RGB24 : CAIRO_FORMAT_ARGB32;
+
+	surface = cairo_image_surface_create (format, width, height);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
 	{
-		g_warning ("Could not open directory: %s", base);
-		return;
+		cairo_surface_destroy (surface);
+		return NULL;
 	}
 
-	while ((d_name = g_dir_read_name (d)) != NULL)
-	{
-		char *path;
+	cairo_surface_flush (surface);
 
-		/* skip hidden files */
-		if (d_name[0] == '.')
-		{
-			continue;
-		}
+	src_row = gdk_pixbuf_read_pixels (pixbuf);
+	src_stride = gdk_pixbuf_get_rowstride (pixbuf);
+	dst_row = cairo_image_surface_get_data (surface);
+	dst_stride = cairo_image_surface_get_stride (surface);
+
+	for (y = 0; y < height; y++)
+	{
+		const guchar *src = src_row;
+		guint32      *dst = (guint32 *) dst_row;
 
-		path = g_build_filename (base, d_name, NULL);
-		if (g_file_test (path, G_FILE_TEST_IS_DIR))
+		if (n_channels == 3)
 		{
-			add_files_to_list (list, path);
-			g_free (path);
+			for (x = 0; x < width; x++, src += 3)
+			{
+				dst[x] = 0xff000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+			}
 		}
 		else
 		{
-			*list = g_slist_prepend (*list, path);
+			for (x = 0; x < width; x++, src += 4)
+			{
+				guint a = src[3];
+
+				dst[x] = (a << 24)
+				         | (PREMULTIPLY (src[0], a) << 16)
+				         | (PREMULTIPLY (src[1], a) << 8)
+				         | PREMULTIPLY (src[2], a);
+			}
 		}
+
+		src_row += src_stride;
+		dst_row += dst_stride;
 	}
 
-	g_dir_close (d);
+	cairo_surface_mark_dirty (surface);
+
+	return surface;
 }
 
-static GSList *
-build_filename_list_local_dir (const char *base)
+/* Hangs successively halved copies of image off it, down to the one
+   closest to covering a width x height screen. */
+static void
+add_mip_levels (cairo_surface_t *image,
+                int              width,
+                int              height)
 {
-	GSList *list = NULL;
+	cairo_surface_t *level;
+	double           cover_width;
+	int              n_levels;
 
-	add_files_to_list (&list, base);
+	cover_width = cairo_image_surface_get_width (image)
+	              * MAX ((double) width / cairo_image_surface_get_width (image),
+	                     (double) height / cairo_image_surface_get_height (image));
 
-	return list;
-}
+	level = image;
+	for (n_levels = 1; n_levels < KB_MAX_LEVELS; n_levels++)
+	{
+		cairo_surface_t *half;
+		cairo_t         *cr;
+		int              lw;
+		int              lh;
 
-static int
-gste_strcmp_compare_func (gconstpointer string_a, gconstpointer string_b)
-{
-	return strcmp (string_a == NULL ? "" : string_a,
-	               string_b == NULL ? "" : string_b);
+		lw = cairo_image_surface_get_width (level);
+		lh = cairo_image_surface_get_height (level);
+
+		/* the next level would be further from the zoomed out size */
+		if (lw / 2.0 < cover_width / G_SQRT2 || lw < 2 || lh < 2)
+		{
+			break;
+		}
+
+		half = cairo_image_surface_create (cairo_image_surface_get_format (level),
+		                                   lw / 2, lh / 2);
+
+		cr = cairo_create (half);
+		cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+		cairo_scale (cr, (double) (lw / 2) / lw, (double) (lh / 2) / lh);
+		cairo_set_source_surface (cr, level, 0, 0);
+		cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_GOOD);
+		cairo_paint (cr);
+		cairo_destroy (cr);
+
+		cairo_surface_set_user_data (level, &mip_level_key, half,
+		                             (cairo_destroy_func_t) cairo_surface_destroy);
+		level = half;
+	}
 }
 
-static GdkPixbuf *
-get_pixbuf_from_local_dir (GSTESlideshow *show,
-                           const char    *location)
+static cairo_surface_t *
+get_image_from_local_dir (GSTESlideshow *show,
+                          const char    *location,
+                          int            width,
+                          int            height,
+                          OpResult      *result)
 {
-	GdkPixbuf *pixbuf, *transformed_pixbuf;
-	char      *filename;
-	int        i;
-	GSList    *l;
+	cairo_surface_t *image;
+	GdkPixbuf       *pixbuf;
+	char            *filename;
+	char            *key;
+	gboolean         cover;
 
-	/* rebuild the cache */
-	if (show->priv->filename_list == NULL)
+	/* the workers share the index */
+	g_mutex_lock (&show->priv->list_lock);
+
+	if (show->priv->image_index != NULL
+	        && strcmp (gste_image_index_get_base (show->priv->image_index), location) != 0)
 	{
-		show->priv->filename_list = build_filename_list_local_dir (location);
+		gste_image_index_free (show->priv->image_index);
+		show->priv->image_index = NULL;
+		show->priv->monitored_serial = 0;
+
+		/* they were for the old location */
+		if (show->priv->index_changes != NULL)
+		{
+			g_hash_table_destroy (show->priv->index_changes);
+			show->priv->index_changes = NULL;
+		}
 	}
 
-	if (show->priv->filename_list == NULL)
+	if (show->priv->image_index == NULL)
 	{
-		return NULL;
+		show->priv->image_index = gste_image_index_new (location);
 	}
-	else
+
+	apply_index_changes (show);
+
+	if (show->priv->monitor_index < show->priv->n_monitors)
 	{
-		if (show->priv->sort_images)
-		{
-			show->priv->filename_list = g_slist_sort (show->priv->filename_list, gste_strcmp_compare_func);
-		}
+		gste_image_index_set_share (show->priv->image_index,
+		                            show->priv->monitor_index,
+		                            show->priv->n_monitors);
 	}
 
-	/* get a random filename if needed */
-	if (! show->priv->sort_images)
+	filename = gste_image_index_next (show->priv->image_index,
+	                                  show->priv->sort_images);
+	if (filename == NULL)
 	{
-		i = g_random_int_range (0, g_slist_length (show->priv->filename_list));
-		l = g_slist_nth (show->priv->filename_list, i);
+		g_mutex_unlock (&show->priv->list_lock);
+		return NULL;
 	}
-	else
+
+	result->seq = show->priv->pick_seq++;
+
+	g_mutex_unlock (&show->priv->list_lock);
+
+	/* panning and zooming needs the image to cover the screen, with
+	 * enough pixels for the closest zoom */
+	cover = result->ken_burns;
+	if (cover)
 	{
-		l = show->priv->filename_list;
+		double zoom;
+
+		zoom = MIN (KB_MAX_ZOOM, sqrt (KB_MAX_PIXELS / ((double) width * height)));
+		zoom = MAX (zoom, 1.0);
+		width = (int) (width * zoom);
+		height = (int) (height * zoom);
 	}
-	filename = l->data;
 
-	pixbuf = gdk_pixbuf_new_from_file (filename, NULL);
+	key = gste_image_cache_get_key (show->priv->image_cache, filename,
+	                                width, height,
+	                                show->priv->no_stretch_hint,
+	                                cover);
 
-	if (pixbuf != NULL)
+	image = NULL;
+	if (key != NULL)
 	{
-		transformed_pixbuf = gdk_pixbuf_apply_embedded_orientation (pixbuf);
-		g_object_unref (pixbuf);
+		image = gste_image_cache_lookup (show->priv->image_cache, key);
 	}
-	else
+
+	if (image == NULL)
 	{
-		transformed_pixbuf = NULL;
+		pixbuf = load_pixbuf_at_size (filename, width, height,
+		                              show->priv->no_stretch_hint,
+		                              cover);
+
+		if (pixbuf != NULL)
+		{
+			image = surface_from_pixbuf (pixbuf);
+			g_object_unref (pixbuf);
+		}
+
+		if (image != NULL && key != NULL)
+		{
+			gste_image_cache_store (show->priv->image_cache, key, image);
+		}
+	}
+
+	g_free (key);
+
+	if (image != NULL && cover)
+	{
+		add_mip_levels (image, result->width, result->height);
 	}
 
-	g_free (filename);
-	show->priv->filename_list = g_slist_delete_link (show->priv->filename_list, l);
+	result->filename = filename;
 
-	return transformed_pixbuf;
+	return image;
 }
 
-static GdkPixbuf *
-get_pixbuf_from_location (GSTESlideshow *show,
-                          const char    *location)
+static cairo_surface_t *
+get_image_from_location (GSTESlideshow *show,
+                         const char    *location,
+                         int            width,
+                         int            height,
+                         OpResult      *result)
 {
-	GdkPixbuf *pixbuf = NULL;
-	gboolean   is_dir;
+	cairo_surface_t *image = NULL;
+	gboolean         is_dir;
 
 	if (location == NULL)
 	{
@@ -628,54 +1887,48 @@ get_pixbuf_from_location (GSTESlideshow *show,
 
 	if (is_dir)
 	{
-		pixbuf = get_pixbuf_from_local_dir (show, location);
+		image = get_image_from_local_dir (show, location, width, height, result);
 	}
 
-	return pixbuf;
+	return image;
 }
 
-static GdkPixbuf *
-get_pixbuf (GSTESlideshow *show,
-            const char    *location,
-            int            width,
-            int            height)
+static cairo_surface_t *
+get_image (GSTESlideshow *show,
+           const char    *location,
+           int            width,
+           int            height,
+           OpResult      *result)
 {
-	GdkPixbuf *pixbuf;
-	GdkPixbuf *scaled = NULL;
-
 	if (location == NULL)
 	{
 		return NULL;
 	}
 
-	pixbuf = get_pixbuf_from_location (show, location);
-
-	if (pixbuf != NULL)
-	{
-		scaled = scale_pixbuf (pixbuf, width, height, show->priv->no_stretch_hint);
-		g_object_unref (pixbuf);
-	}
-
-	return scaled;
+	return get_image_from_location (show, location, width, height, result);
 }
 
 static void
-op_load_image (GSTESlideshow *show,
-               const char    *location)
+load_func (Op            *op,
+           GSTESlideshow *show)
 {
 	OpResult *op_result;
-	int       window_width;
-	int       window_height;
-
-	window_width = show->priv->window_width;
-	window_height = show->priv->window_height;
 
 	op_result = g_new0 (OpResult, 1);
 
-	op_result->pixbuf = get_pixbuf (show,
-	                                location,
-	                                window_width,
-	                                window_height);
+	op_result->slideshow = op->slideshow;
+	op_result->seq = -1;
+	op_result->width = op->width;
+	op_result->height = op->height;
+	op_result->ken_burns = op->ken_burns;
+	op_result->image = get_image (show,
+	                              op->location,
+	                              op->width,
+	                              op->height,
+	                              op_result);
+
+	g_free (op->location);
+	g_free (op);
 
 	g_async_queue_lock (show->priv->results_q);
 	g_async_queue_push_unlocked (show->priv->results_q, op_result);
@@ -690,30 +1943,6 @@ op_load_image (GSTESlideshow *show,
 	g_async_queue_unlock (show->priv->results_q);
 }
 
-static gpointer
-load_threadfunc (GAsyncQueue *op_q)
-{
-	Op *op;
-
-	op = g_async_queue_pop (op_q);
-	while (op)
-	{
-		op_load_image (op->slideshow,
-		               op->location);
-
-		if (op->slideshow != NULL)
-		{
-			g_object_unref (op->slideshow);
-		}
-		g_free (op->location);
-		g_free (op);
-
-		op = g_async_queue_pop (op_q);
-	}
-
-	return NULL;
-}
-
 void
 gste_slideshow_set_images_location (GSTESlideshow *show,
                                     const char    *location)
@@ -742,6 +1971,99 @@ gste_slideshow_set_no_stretch_hint (GSTESlideshow *show,
 	show->priv->no_stretch_hint = no_stretch_hint;
 }
 
+void
+gste_slideshow_set_prefetch_depth (GSTESlideshow *show,
+                                   int            prefetch_depth)
+{
+	g_return_if_fail (GSTE_IS_SLIDESHOW (show));
+
+	show->priv->prefetch_depth = MAX (prefetch_depth, 1);
+
+	fill_pipeline (show);
+}
+
+void
+gste_slideshow_set_decode_threads (GSTESlideshow *show,
+                                   int            decode_threads)
+{
+	g_return_if_fail (GSTE_IS_SLIDESHOW (show));
+
+	show->priv->decode_threads = MAX (decode_threads, 1);
+
+	g_thread_pool_set_max_threads (show->priv->load_pool,
+	                               show->priv->decode_threads,
+	                               NULL);
+}
+
+void
+gste_slideshow_set_cache_size (GSTESlideshow *show,
+                               int            cache_size)
+{
+	g_return_if_fail (GSTE_IS_SLIDESHOW (show));
+
+	show->priv->cache_size = MAX (cache_size, 0);
+
+	gste_image_cache_set_max_size (show->priv->image_cache,
+	                               (goffset) show->priv->cache_size * 1024 * 1024);
+}
+
+void
+gste_slideshow_set_ken_burns (GSTESlideshow *show,
+                              gboolean       ken_burns)
+{
+	g_return_if_fail (GSTE_IS_SLIDESHOW (show));
+
+	if (show->priv->ken_burns == ken_burns)
+	{
+		return;
+	}
+
+	show->priv->ken_burns = ken_burns;
+
+	/* images already decoded were sized for the other mode */
+	stop_frames (show);
+	clear_fade (show);
+	kb_clear (show);
+
+	if (show->priv->surf != NULL)
+	{
+		start_new_load (show, 10);
+		fill_pipeline (show);
+	}
+}
+
+void
+gste_slideshow_set_ken_burns_fps (GSTESlideshow *show,
+                                  int            fps)
+{
+	g_return_if_fail (GSTE_IS_SLIDESHOW (show));
+
+	show->priv->ken_burns_fps = CLAMP (fps, 1, 60);
+	show->priv->kb_interval = 1000 / show->priv->ken_burns_fps;
+}
+
+void
+gste_slideshow_set_monitor_index (GSTESlideshow *show,
+                                  int            monitor_index)
+{
+	g_return_if_fail (GSTE_IS_SLIDESHOW (show));
+
+	g_mutex_lock (&show->priv->list_lock);
+	show->priv->monitor_index = MAX (monitor_index, 0);
+	g_mutex_unlock (&show->priv->list_lock);
+}
+
+void
+gste_slideshow_set_n_monitors (GSTESlideshow *show,
+                               int            n_monitors)
+{
+	g_return_if_fail (GSTE_IS_SLIDESHOW (show));
+
+	g_mutex_lock (&show->priv->list_lock);
+	show->priv->n_monitors = MAX (n_monitors, 1);
+	g_mutex_unlock (&show->priv->list_lock);
+}
+
 void
 gste_slideshow_set_background_color (GSTESlideshow *show,
                                      const char    *background_color)
@@ -790,6 +2112,27 @@ gste_slideshow_set_property (GObject            *object,
 	case PROP_NO_STRETCH_HINT:
 		gste_slideshow_set_no_stretch_hint (self, g_value_get_boolean (value));
 		break;
+	case PROP_PREFETCH_DEPTH:
+		gste_slideshow_set_prefetch_depth (self, g_value_get_int (value));
+		break;
+	case PROP_DECODE_THREADS:
+		gste_slideshow_set_decode_threads (self, g_value_get_int (value));
+		break;
+	case PROP_CACHE_SIZE:
+		gste_slideshow_set_cache_size (self, g_value_get_int (value));
+		break;
+	case PROP_KEN_BURNS:
+		gste_slideshow_set_ken_burns (self, g_value_get_boolean (value));
+		break;
+	case PROP_KEN_BURNS_FPS:
+		gste_slideshow_set_ken_burns_fps (self, g_value_get_int (value));
+		break;
+	case PROP_MONITOR_INDEX:
+		gste_slideshow_set_monitor_index (self, g_value_get_int (value));
+		break;
+	case PROP_N_MONITORS:
+		gste_slideshow_set_n_monitors (self, g_value_get_int (value));
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -825,6 +2168,27 @@ gste_slideshow_get_property (GObject            *object,
 	case PROP_NO_STRETCH_HINT:
 		g_value_set_boolean (value, self->priv->no_stretch_hint);
 		break;
+	case PROP_PREFETCH_DEPTH:
+		g_value_set_int (value, self->priv->prefetch_depth);
+		break;
+	case PROP_DECODE_THREADS:
+		g_value_set_int (value, self->priv->decode_threads);
+		break;
+	case PROP_CACHE_SIZE:
+		g_value_set_int (value, self->priv->cache_size);
+		break;
+	case PROP_KEN_BURNS:
+		g_value_set_boolean (value, self->priv->ken_burns);
+		break;
+	case PROP_KEN_BURNS_FPS:
+		g_value_set_int (value, self->priv->ken_burns_fps);
+		break;
+	case PROP_MONITOR_INDEX:
+		g_value_set_int (value, self->priv->monitor_index);
+		break;
+	case PROP_N_MONITORS:
+		g_value_set_int (value, self->priv->n_monitors);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -835,7 +2199,6 @@ static void
 gste_slideshow_real_show (GtkWidget *widget)
 {
 	GSTESlideshow *show = GSTE_SLIDESHOW (widget);
-	int            delay;
 
 	if (GTK_WIDGET_CLASS (parent_class)->show)
 	{
@@ -844,9 +2207,6 @@ gste_slideshow_real_show (GtkWidget *widget)
 
 	start_new_load (show, 10);
 
-	delay = 25;
-	show->priv->timeout_id = g_timeout_add (delay, (GSourceFunc)draw_iter, show);
-
 	if (show->priv->timer != NULL)
 	{
 		g_timer_destroy (show->priv->timer);
@@ -886,9 +2246,8 @@ gste_slideshow_real_configure (GtkWidget         *widget,
 	                                 &show->priv->window_width,
 	                                 &show->priv->window_height);
 
-	gs_theme_engine_profile_msg ("Resize to x:%d y:%d",
-	                             show->priv->window_width,
-	                             show->priv->window_height);
+	gs_theme_engine_profile_value ("window width", show->priv->window_width);
+	gs_theme_engine_profile_value ("window height", show->priv->window_height);
 
 	if (show->priv->surf != NULL)
 	{
@@ -902,9 +2261,28 @@ gste_slideshow_real_configure (GtkWidget         *widget,
 	                   show->priv->window_height);
 	cairo_destroy (cr);
 
+	cr = cairo_create (show->priv->surf);
+	set_source_background (show, cr);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+
+	show->priv->cur_rect.width = 0;
+	show->priv->cur_rect.height = 0;
+
+	/* a fade in progress was for the old size */
+	if (show->priv->next_surf != NULL)
+	{
+		clear_fade (show);
+		stop_frames (show);
+		start_new_load (show, 10);
+	}
+
 	/* schedule a redraw */
 	gtk_widget_queue_draw (widget);
 
+	/* start decoding for the new size */
+	fill_pipeline (show);
+
 	if (GTK_WIDGET_CLASS (parent_class)->configure_event)
 	{
 		handled = GTK_WIDGET_CLASS (parent_class)->configure_event (widget, event);
@@ -916,8 +2294,9 @@ gste_slideshow_real_configure (GtkWidget         *widget,
 static void
 gste_slideshow_class_init (GSTESlideshowClass *klass)
 {
-	GObjectClass   *object_class = G_OBJECT_CLASS (klass);
-	GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+	GObjectClass       *object_class = G_OBJECT_CLASS (klass);
+	GtkWidgetClass     *widget_class = GTK_WIDGET_CLASS (klass);
+	GSThemeEngineClass *engine_class = GS_THEME_ENGINE_CLASS (klass);
 
 	parent_class = g_type_class_peek_parent (klass);
 
@@ -929,6 +2308,8 @@ gste_slideshow_class_init (GSTESlideshowClass *klass)
 	widget_class->draw = gste_slideshow_real_draw;
 	widget_class->configure_event = gste_slideshow_real_configure;
 
+	engine_class->tick = gste_slideshow_tick;
+
 	g_object_class_install_property (object_class,
 	                                 PROP_IMAGES_LOCATION,
 	                                 g_param_spec_string ("images-location",
@@ -957,6 +2338,67 @@ gste_slideshow_class_init (GSTESlideshowClass *klass)
 	                                         NULL,
 	                                         FALSE,
 	                                         G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+	                                 PROP_PREFETCH_DEPTH,
+	                                 g_param_spec_int ("prefetch-depth",
+	                                         NULL,
+	                                         NULL,
+	                                         1,
+	                                         16,
+	                                         DEFAULT_PREFETCH_DEPTH,
+	                                         G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+	                                 PROP_DECODE_THREADS,
+	                                 g_param_spec_int ("decode-threads",
+	                                         NULL,
+	                                         NULL,
+	                                         1,
+	                                         16,
+	                                         DEFAULT_DECODE_THREADS,
+	                                         G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+	                                 PROP_CACHE_SIZE,
+	                                 g_param_spec_int ("cache-size",
+	                                         NULL,
+	                                         NULL,
+	                                         0,
+	                                         G_MAXINT,
+	                                         DEFAULT_CACHE_SIZE,
+	                                         G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+	                                 PROP_KEN_BURNS,
+	                                 g_param_spec_boolean ("ken-burns",
+	                                         NULL,
+	                                         NULL,
+	                                         FALSE,
+	                                         G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+	                                 PROP_KEN_BURNS_FPS,
+	                                 g_param_spec_int ("ken-burns-fps",
+	                                         NULL,
+	                                         NULL,
+	                                         1,
+	                                         60,
+	                                         DEFAULT_KEN_BURNS_FPS,
+	                                         G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+	                                 PROP_MONITOR_INDEX,
+	                                 g_param_spec_int ("monitor-index",
+	                                         NULL,
+	                                         NULL,
+	                                         0,
+	                                         G_MAXINT,
+	                                         0,
+	                                         G_PARAM_READWRITE));
+	g_object_class_install_property (object_class,
+	                                 PROP_N_MONITORS,
+	                                 g_param_spec_int ("n-monitors",
+	                                         NULL,
+	                                         NULL,
+	                                         1,
+	                                         G_MAXINT,
+	                                         1,
+	                                         G_PARAM_READWRITE));
 }
 
 static void
@@ -982,10 +2424,39 @@ gste_slideshow_init (GSTESlideshow *show)
 
 	show->priv->images_location = g_strdup (DEFAULT_IMAGES_LOCATION);
 
-	show->priv->op_q = g_async_queue_new ();
+	show->priv->fade_steps = N_FADE_TICKS;
+	show->priv->ken_burns_fps = DEFAULT_KEN_BURNS_FPS;
+	show->priv->n_monitors = 1;
+	show->priv->kb_interval = 1000 / DEFAULT_KEN_BURNS_FPS;
+	show->priv->prefetch_depth = DEFAULT_PREFETCH_DEPTH;
+	show->priv->decode_threads = DEFAULT_DECODE_THREADS;
+
+	show->priv->cache_size = DEFAULT_CACHE_SIZE;
+	show->priv->image_cache = gste_image_cache_new ("slideshow",
+	                          (goffset) DEFAULT_CACHE_SIZE * 1024 * 1024);
+
+	show->priv->monitors = g_hash_table_new_full (g_str_hash,
+	                                              g_str_equal,
+	                                              g_free,
+	                                              (GDestroyNotify)monitor_free);
+	show->priv->changes = g_hash_table_new_full (g_str_hash,
+	                                             g_str_equal,
+	                                             g_free,
+	                                             NULL);
+	show->priv->removed = g_hash_table_new_full (g_str_hash,
+	                                             g_str_equal,
+	                                             g_free,
+	                                             NULL);
+
+	g_mutex_init (&show->priv->list_lock);
+	show->priv->ready = g_queue_new ();
 	show->priv->results_q = g_async_queue_new ();
 
-	g_thread_new ("loadthread", (GThreadFunc)load_threadfunc, show->priv->op_q);
+	show->priv->load_pool = g_thread_pool_new ((GFunc)load_func,
+	                                           show,
+	                                           show->priv->decode_threads,
+	                                           FALSE,
+	                                           NULL);
 
 	set_visual (GTK_WIDGET (show));
 }
@@ -1008,11 +2479,8 @@ gste_slideshow_finalize (GObject *object)
 		cairo_surface_destroy (show->priv->surf);
 	}
 
-	if (show->priv->timeout_id > 0)
-	{
-		g_source_remove (show->priv->timeout_id);
-		show->priv->timeout_id = 0;
-	}
+	clear_fade (show);
+	kb_clear (show);
 
 	if (show->priv->results_pull_id > 0)
 	{
@@ -1020,6 +2488,28 @@ gste_slideshow_finalize (GObject *object)
 		show->priv->results_pull_id = 0;
 	}
 
+	if (show->priv->update_image_id > 0)
+	{
+		g_source_remove (show->priv->update_image_id);
+		show->priv->update_image_id = 0;
+	}
+
+	if (show->priv->changes_id > 0)
+	{
+		g_source_remove (show->priv->changes_id);
+		show->priv->changes_id = 0;
+	}
+
+	g_hash_table_destroy (show->priv->monitors);
+	g_hash_table_destroy (show->priv->changes);
+	g_hash_table_destroy (show->priv->removed);
+
+	/* every queued load holds a reference, so the workers are idle */
+	if (show->priv->load_pool != NULL)
+	{
+		g_thread_pool_free (show->priv->load_pool, TRUE, TRUE);
+	}
+
 	if (show->priv->results_q != NULL)
 	{
 		result = g_async_queue_try_pop (show->priv->results_q);
@@ -1031,6 +2521,18 @@ gste_slideshow_finalize (GObject *object)
 		g_async_queue_unref (show->priv->results_q);
 	}
 
+	g_list_free_full (show->priv->pending, (GDestroyNotify)op_result_free);
+	g_queue_free_full (show->priv->ready, (GDestroyNotify)op_result_free);
+
+	if (show->priv->index_changes != NULL)
+	{
+		g_hash_table_destroy (show->priv->index_changes);
+	}
+	gste_image_index_free (show->priv->image_index);
+	g_mutex_clear (&show->priv->list_lock);
+
+	gste_image_cache_free (show->priv->image_cache);
+
 	g_free (show->priv->images_location);
 	show->priv->images_location = NULL;
 
@@ -65,6 +65,27 @@ void            gste_slideshow_set_background_color (GSTESlideshow *show,
 void            gste_slideshow_set_no_stretch_hint  (GSTESlideshow *show,
         gboolean       no_stretch_hint);
 
+void            gste_slideshow_set_prefetch_depth   (GSTESlideshow *show,
+        int            prefetch_depth);
+
+void            gste_slideshow_set_decode_threads   (GSTESlideshow *show,
+        int            decode_threads);
+
+void            gste_slideshow_set_cache_size       (GSTESlideshow *show,
+        int            cache_size);
+
+void            gste_slideshow_set_ken_burns        (GSTESlideshow *show,
+        gboolean       ken_burns);
+
+void            gste_slideshow_set_ken_burns_fps    (GSTESlideshow *show,
+        int            fps);
+
+void            gste_slideshow_set_monitor_index    (GSTESlideshow *show,
+        int            monitor_index);
+
+void            gste_slideshow_set_n_monitors       (GSTESlideshow *show,
+        int            n_monitors);
+
 G_END_DECLS
 
 #endif /* __GSTE_SLIDESHOW_H */
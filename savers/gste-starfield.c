@@ -34,18 +34,18 @@
 #include "gs-theme-engine.h"
 #include "gste-starfield.h"
 
+/* brightness and radius only depend on the depth; stars within the
+ * same slice of it are drawn together */
+#define N_BUCKETS 64
+
 static void     gste_starfield_finalize    (GObject             *object);
 static void     draw_frame                 (GSTEStarfield       *sf,
                                             cairo_t *cr);
 
-typedef struct _point
-{
-	gdouble x, y, z;
-} point;
-
 struct GSTEStarfieldPrivate
 {
-	guint         timeout_id;
+	/* frame time of the last frame drawn */
+	int64_t       last_frame;
 	int64_t       timestamp;
 	unsigned int  count;
 	double        speed;
@@ -53,7 +53,20 @@ struct GSTEStarfieldPrivate
 	double        acceleration;
 	guint         delay;
 	double        size;
-	point        *stars;
+
+	/* one array per coordinate, so that the update loops run over
+	 * contiguous floats and can be vectorized */
+	float        *star_x;
+	float        *star_y;
+	float        *star_z;
+	/* per frame: where the stars are drawn, their depth bucket and
+	 * their indexes sorted by bucket */
+	float        *screen_x;
+	float        *screen_y;
+	guint8       *bucket;
+	guint        *order;
+	guint         bucket_start[N_BUCKETS + 1];
+	guint32       rng_state;
 };
 
 enum
@@ -84,7 +97,7 @@ G_DEFINE_TYPE_WITH_PRIVATE (GSTEStarfield, gste_starfield, GS_TYPE_THEME_ENGINE)
 #define SPEED_FACTOR 0.25
 
 #define DEFAULT_COUNT 200
-#define MAX_COUNT 500
+#define MAX_COUNT 5000
 #define MIN_COUNT 1
 
 #define DEFAULT_DELAY 15
@@ -162,45 +175,100 @@ gste_starfield_get_property (GObject            *object,
 	}
 }
 
-static void
-setup_stars (GSTEStarfield *sf)
+/* xorshift32, plenty for placing stars and much cheaper than
+   g_random_double_range() */
+static inline float
+random_float (GSTEStarfield *sf)
 {
-	int i;
+	guint32 x = sf->priv->rng_state;
 
-	if (sf->priv->stars)
-	{
-		g_free (sf->priv->stars);
-	}
-	sf->priv->stars = g_new(point, sf->priv->count);
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	sf->priv->rng_state = x;
+
+	/* [0, 1) from the top 24 bits */
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+static inline float
+random_float_range (GSTEStarfield *sf,
+                    float          begin,
+                    float          end)
+{
+	return begin + (end - begin) * random_float (sf);
+}
+
+static void
+free_stars (GSTEStarfield *sf)
+{
+	g_free (sf->priv->star_x);
+	g_free (sf->priv->star_y);
+	g_free (sf->priv->star_z);
+	g_free (sf->priv->screen_x);
+	g_free (sf->priv->screen_y);
+	g_free (sf->priv->bucket);
+	g_free (sf->priv->order);
+}
 
-	for (i = 0; i < sf->priv->count; ++i)
+static void
+setup_stars (GSTEStarfield *sf)
+{
+	guint n = sf->priv->count;
+	guint i;
+
+	free_stars (sf);
+	sf->priv->star_x = g_new (float, n);
+	sf->priv->star_y = g_new (float, n);
+	sf->priv->star_z = g_new (float, n);
+	sf->priv->screen_x = g_new (float, n);
+	sf->priv->screen_y = g_new (float, n);
+	sf->priv->bucket = g_new (guint8, n);
+	sf->priv->order = g_new (guint, n);
+
+	/* never zero, or the generator gets stuck */
+	sf->priv->rng_state = g_random_int () | 1;
+
+	for (i = 0; i < n; ++i)
 	{
-		point *s = &sf->priv->stars[i];
-		s->z = -cbrt(g_random_double() - 1); /* icdf for beta(1, 3) distribution */
-		s->x = s->z * g_random_double_range(-XY_CLIP_LIMIT, XY_CLIP_LIMIT);
-		s->y = s->z * g_random_double_range(-XY_CLIP_LIMIT, XY_CLIP_LIMIT);
+		float z = -cbrtf (random_float (sf) - 1); /* icdf for beta(1, 3) distribution */
+		sf->priv->star_z[i] = z;
+		sf->priv->star_x[i] = z * random_float_range (sf, -XY_CLIP_LIMIT, XY_CLIP_LIMIT);
+		sf->priv->star_y[i] = z * random_float_range (sf, -XY_CLIP_LIMIT, XY_CLIP_LIMIT);
 	}
 	sf->priv->timestamp = g_get_monotonic_time ();
+	sf->priv->last_frame = 0;
 	sf->priv->current_speed = 0.0;
 }
 
+/* Time since the previous frame, from the frame clock so that the
+   motion matches when frames are shown */
 static double
 get_elapsed_time (GSTEStarfield *sf)
 {
 	int64_t prev_timestamp = sf->priv->timestamp;
 
-	sf->priv->timestamp = g_get_monotonic_time ();
+	sf->priv->timestamp = MAX (sf->priv->last_frame, prev_timestamp);
 
 	int64_t elapsed = sf->priv->timestamp - prev_timestamp;
 
 	return (double)elapsed / 1e6;
 }
 
-static gboolean
-draw_iter (GSTEStarfield *sf)
+static void
+gste_starfield_tick (GSThemeEngine *engine,
+                     gint64         frame_time)
 {
+	GSTEStarfield *sf = GSTE_STARFIELD (engine);
+
+	/* the delay is the shortest time between frames */
+	if (frame_time - sf->priv->last_frame < (gint64) sf->priv->delay * 1000)
+	{
+		return;
+	}
+
+	sf->priv->last_frame = frame_time;
 	gtk_widget_queue_draw (GTK_WIDGET (sf));
-	return TRUE;
 }
 
 static void
@@ -211,13 +279,7 @@ gste_starfield_real_show (GtkWidget *widget)
 	/* start */
 	setup_stars (sf);
 
-	if (sf->priv->timeout_id > 0)
-	{
-		g_source_remove (sf->priv->timeout_id);
-	}
-	sf->priv->timeout_id = g_timeout_add (sf->priv->delay,
-	                                      (GSourceFunc)draw_iter,
-	                                      sf);
+	gs_theme_engine_start_ticks (GS_THEME_ENGINE (sf));
 
 	if (GTK_WIDGET_CLASS (parent_class)->show)
 	{
@@ -264,8 +326,9 @@ gste_starfield_real_configure (GtkWidget         *widget,
 static void
 gste_starfield_class_init (GSTEStarfieldClass *klass)
 {
-	GObjectClass   *object_class = G_OBJECT_CLASS (klass);
-	GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+	GObjectClass       *object_class = G_OBJECT_CLASS (klass);
+	GtkWidgetClass     *widget_class = GTK_WIDGET_CLASS (klass);
+	GSThemeEngineClass *engine_class = GS_THEME_ENGINE_CLASS (klass);
 
 	parent_class = g_type_class_peek_parent (klass);
 
@@ -277,6 +340,8 @@ gste_starfield_class_init (GSTEStarfieldClass *klass)
 	widget_class->draw = gste_starfield_real_draw;
 	widget_class->configure_event = gste_starfield_real_configure;
 
+	engine_class->tick = gste_starfield_tick;
+
 	g_object_class_install_property (object_class,
 	                                 PROP_COUNT,
 	                                 g_param_spec_int ("count",
@@ -324,11 +389,96 @@ gste_starfield_class_init (GSTEStarfieldClass *klass)
 	                                         G_PARAM_READWRITE));
 }
 
+/* Moves the stars towards the camera and replaces the ones that went
+   past it or out of view with new ones far away */
+static void
+update_stars (GSTEStarfield *sf,
+              double         step)
+{
+	float *xs = sf->priv->star_x;
+	float *ys = sf->priv->star_y;
+	float *zs = sf->priv->star_z;
+	float  fstep = step;
+	float  spawn_depth = fmin (step, Z_FAR - Z_NEAR);
+	guint  n = sf->priv->count;
+	guint  i;
+
+	/* no branches, so this is vectorized */
+	for (i = 0; i < n; ++i)
+	{
+		zs[i] -= fstep;
+	}
+
+	for (i = 0; i < n; ++i)
+	{
+		float z = zs[i];
+		float limit = z * XY_CLIP_LIMIT;
+
+		if (z <= Z_NEAR ||
+		    fabsf (xs[i]) > limit ||
+		    fabsf (ys[i]) > limit)
+		{
+			z = Z_FAR - random_float_range (sf, 0, spawn_depth);
+			zs[i] = z;
+			xs[i] = z * random_float_range (sf, -XY_CLIP_LIMIT, XY_CLIP_LIMIT);
+			ys[i] = z * random_float_range (sf, -XY_CLIP_LIMIT, XY_CLIP_LIMIT);
+		}
+	}
+}
+
+/* Projects the stars onto the window and sorts them by depth bucket */
+static void
+project_stars (GSTEStarfield *sf,
+               int            window_width,
+               int            window_height)
+{
+	const float *xs = sf->priv->star_x;
+	const float *ys = sf->priv->star_y;
+	const float *zs = sf->priv->star_z;
+	float       *sx = sf->priv->screen_x;
+	float       *sy = sf->priv->screen_y;
+	guint8      *bucket = sf->priv->bucket;
+	guint       *start = sf->priv->bucket_start;
+	guint        next[N_BUCKETS];
+	float        width = window_width;
+	float        height = window_height;
+	guint        n = sf->priv->count;
+	guint        i;
+
+	/* vectorized as well */
+	for (i = 0; i < n; ++i)
+	{
+		float inv_z = 1.0f / zs[i];
+		int   b = (int) (zs[i] * N_BUCKETS);
+
+		sx[i] = (xs[i] * inv_z + XY_CLIP_LIMIT) * width;
+		sy[i] = (ys[i] * inv_z + XY_CLIP_LIMIT) * height;
+		bucket[i] = CLAMP (b, 0, N_BUCKETS - 1);
+	}
+
+	/* counting sort */
+	memset (start, 0, sizeof (sf->priv->bucket_start));
+	for (i = 0; i < n; ++i)
+	{
+		start[bucket[i] + 1]++;
+	}
+	for (i = 1; i <= N_BUCKETS; ++i)
+	{
+		start[i] += start[i - 1];
+	}
+	memcpy (next, start, sizeof (next));
+	for (i = 0; i < n; ++i)
+	{
+		sf->priv->order[next[bucket[i]]++] = i;
+	}
+}
+
 static void
 draw_frame (GSTEStarfield *sf,
             cairo_t       *cr)
 {
-	int i;
+	guint i;
+	int b;
 	int window_width;
 	int window_height;
 	GdkWindow *window;
@@ -349,36 +499,40 @@ draw_frame (GSTEStarfield *sf,
 	double step = SPEED_FACTOR * speed * elapsed;
 	double max_radius = fmax(sf->priv->size * SIZE_RATIO * window_height, 1);
 
+	update_stars (sf, step);
+	project_stars (sf, window_width, window_height);
+
 	cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
 	cairo_set_antialias (cr, CAIRO_ANTIALIAS_FAST);
 
-	for (i = 0; i < sf->priv->count; ++i)
+	/* one stroke per bucket, far ones first: every star in it is a
+	 * dot of the same brightness and radius, taken at the middle of
+	 * the bucket */
+	for (b = N_BUCKETS - 1; b >= 0; --b)
 	{
-		point *s = &sf->priv->stars[i];
+		guint begin = sf->priv->bucket_start[b];
+		guint end = sf->priv->bucket_start[b + 1];
 
-		s->z -= step;
-
-		if (s->z <= Z_NEAR ||
-		    s->x > s->z *  XY_CLIP_LIMIT ||
-		    s->x < s->z * -XY_CLIP_LIMIT ||
-		    s->y > s->z *  XY_CLIP_LIMIT ||
-		    s->y < s->z * -XY_CLIP_LIMIT)
+		if (begin == end)
 		{
-			s->z = Z_FAR - g_random_double_range(0, fmin(step, Z_FAR - Z_NEAR));
-			s->x = s->z * g_random_double_range(-XY_CLIP_LIMIT, XY_CLIP_LIMIT);
-			s->y = s->z * g_random_double_range(-XY_CLIP_LIMIT, XY_CLIP_LIMIT);
+			continue;
 		}
 
-		double x = (s->x / s->z + XY_CLIP_LIMIT) * window_width;
-		double y = (s->y / s->z + XY_CLIP_LIMIT) * window_height;
-		double illum = 1.0 / (1.0 + s->z);
+		double z = (b + 0.5) / N_BUCKETS;
+		double illum = 1.0 / (1.0 + z);
 		illum *= illum;
-		double radius = max_radius * (1.0 - s->z);
+		double radius = max_radius * (1.0 - z);
+
+		for (i = begin; i < end; ++i)
+		{
+			guint j = sf->priv->order[i];
+
+			cairo_move_to (cr, sf->priv->screen_x[j], sf->priv->screen_y[j]);
+			cairo_line_to (cr, sf->priv->screen_x[j], sf->priv->screen_y[j]);
+		}
 
 		cairo_set_source_rgb (cr, illum, illum, illum);
 		cairo_set_line_width (cr, radius);
-		cairo_move_to (cr, x, y);
-		cairo_line_to (cr, x, y);
 		cairo_stroke (cr);
 	}
 	if (speed != sf->priv->speed)
@@ -412,13 +566,7 @@ gste_starfield_finalize (GObject *object)
 
 	g_return_if_fail (sf->priv != NULL);
 
-	if (sf->priv->timeout_id > 0)
-	{
-		g_source_remove (sf->priv->timeout_id);
-		sf->priv->timeout_id = 0;
-	}
-
-	g_free (sf->priv->stars);
+	free_stars (sf);
 
 	G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -38,6 +38,15 @@ main (int argc, char **argv)
 	GSThemeEngine *engine;
 	GtkWidget     *window;
 	GError        *error;
+	gint           subdivision = 0;
+	GOptionEntry  entries [] =
+	{
+		{
+			"subdivision", 0, 0, G_OPTION_ARG_INT, &subdivision,
+			N_("Number of squares along each side [1-400]"), N_("NUM")
+		},
+		{ NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+	};
 
 	bindtextdomain (GETTEXT_PACKAGE, MATELOCALEDIR);
 	bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
@@ -45,7 +54,7 @@ main (int argc, char **argv)
 
 	error = NULL;
 
-	if (!gtk_init_with_args (&argc, &argv, NULL, NULL, NULL, &error))
+	if (!gtk_init_with_args (&argc, &argv, NULL, entries, NULL, &error))
 	{
 		g_printerr (_("%s. See --help for usage information.\n"),
 		            error->message);
@@ -61,6 +70,11 @@ main (int argc, char **argv)
 	g_set_prgname ("popsquares");
 
 	engine = g_object_new (GSTE_TYPE_POPSQUARES, NULL);
+
+	if (subdivision > 0)
+	{
+		g_object_set (engine, "subdivision", subdivision, NULL);
+	}
 	gtk_container_add (GTK_CONTAINER (window), GTK_WIDGET (engine));
 
 	gtk_widget_show (GTK_WIDGET (engine));
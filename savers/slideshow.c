@@ -49,6 +49,13 @@ main (int argc, char **argv)
 	char          *background_color = NULL;
 	gboolean       sort_images = FALSE;
 	gboolean       no_stretch = FALSE;
+	int            prefetch_depth = 0;
+	int            decode_threads = 0;
+	int            cache_size = -1;
+	gboolean       ken_burns = FALSE;
+	int            ken_burns_fps = 0;
+	const char    *monitor_env;
+	const char    *n_monitors_env;
 	GOptionEntry  entries [] =
 	{
 		{
@@ -67,6 +74,26 @@ main (int argc, char **argv)
 			"no-stretch", 0, 0, G_OPTION_ARG_NONE, &no_stretch,
 			N_("Do not try to stretch images on screen"), NULL
 		},
+		{
+			"prefetch-depth", 0, 0, G_OPTION_ARG_INT, &prefetch_depth,
+			N_("Number of images to decode ahead of time"), N_("N")
+		},
+		{
+			"decode-threads", 0, 0, G_OPTION_ARG_INT, &decode_threads,
+			N_("Number of threads used to decode images"), N_("N")
+		},
+		{
+			"cache-size", 0, 0, G_OPTION_ARG_INT, &cache_size,
+			N_("Size of the scaled image cache in megabytes, 0 to disable it"), N_("MB")
+		},
+		{
+			"ken-burns", 0, 0, G_OPTION_ARG_NONE, &ken_burns,
+			N_("Slowly pan and zoom over the images"), NULL
+		},
+		{
+			"ken-burns-fps", 0, 0, G_OPTION_ARG_INT, &ken_burns_fps,
+			N_("Frame rate of the pan and zoom"), N_("FPS")
+		},
 		{ NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
 	};
 
@@ -131,6 +158,51 @@ main (int argc, char **argv)
 		g_object_set (engine, "no-stretch", no_stretch, NULL);
 	}
 
+	if (prefetch_depth > 0)
+	{
+		g_object_set (engine, "prefetch-depth", prefetch_depth, NULL);
+	}
+
+	if (decode_threads > 0)
+	{
+		g_object_set (engine, "decode-threads", decode_threads, NULL);
+	}
+
+	if (cache_size >= 0)
+	{
+		g_object_set (engine, "cache-size", cache_size, NULL);
+	}
+
+	if (ken_burns)
+	{
+		g_object_set (engine, "ken-burns", ken_burns, NULL);
+	}
+
+	if (ken_burns_fps > 0)
+	{
+		g_object_set (engine, "ken-burns-fps", ken_burns_fps, NULL);
+	}
+
+	/* set by the screensaver when it runs one slideshow per monitor */
+	monitor_env = g_getenv ("MATE_SCREENSAVER_MONITOR");
+	n_monitors_env = g_getenv ("MATE_SCREENSAVER_N_MONITORS");
+	if (monitor_env != NULL && n_monitors_env != NULL)
+	{
+		int monitor_index;
+		int n_monitors;
+
+		monitor_index = atoi (monitor_env);
+		n_monitors = atoi (n_monitors_env);
+
+		if (monitor_index >= 0 && monitor_index < n_monitors)
+		{
+			g_object_set (engine,
+			              "monitor-index", monitor_index,
+			              "n-monitors", n_monitors,
+			              NULL);
+		}
+	}
+
 	gtk_container_add (GTK_CONTAINER (window), GTK_WIDGET (engine));
 
 	gtk_widget_show (GTK_WIDGET (engine));
@@ -48,7 +48,7 @@ main (int argc, char **argv)
 	{
 		{
 			"count", 'c', 0, G_OPTION_ARG_INT, &count,
-			N_("Number of stars [1-500]"), N_("NUM")
+			N_("Number of stars [1-5000]"), N_("NUM")
 		},
 		{
 			"speed", 's', 0, G_OPTION_ARG_DOUBLE, &speed,
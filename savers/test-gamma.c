@@ -0,0 +1,131 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "gste-gamma.h"
+
+#define GAMMA 2.2
+
+/* width is odd and the rows are padded, like small pixbufs are */
+#define WIDTH     37
+#define HEIGHT    11
+#define ROWSTRIDE (WIDTH * 4 + 12)
+
+/* what gste_gamma_correct_alpha() must match, one pow() per pixel */
+static void
+reference_correct_alpha (guchar *pixels,
+                         int     width,
+                         int     height,
+                         int     rowstride,
+                         gdouble gamma)
+{
+	int x, y;
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			guchar *alpha = pixels + y * rowstride + x * 4 + 3;
+
+			*alpha = (guchar) (255 * pow (*alpha / 255.0, 1.0 / gamma));
+		}
+	}
+}
+
+static gboolean
+test_gamma (guint32 seed)
+{
+	GRand  *rand;
+	guchar *expected;
+	guchar *pixels;
+	gsize   size;
+	gsize   i;
+	gboolean ok;
+
+	size = ROWSTRIDE * HEIGHT;
+	expected = g_malloc (size);
+
+	rand = g_rand_new_with_seed (seed);
+	for (i = 0; i < size; i++)
+	{
+		expected[i] = g_rand_int_range (rand, 0, 256);
+	}
+	g_rand_free (rand);
+
+	/* every alpha value is seen at least once */
+	for (i = 0; i < 256; i++)
+	{
+		expected[(i / WIDTH) * ROWSTRIDE + (i % WIDTH) * 4 + 3] = i;
+	}
+
+	pixels = g_malloc (size);
+	memcpy (pixels, expected, size);
+
+	reference_correct_alpha (expected, WIDTH, HEIGHT, ROWSTRIDE, GAMMA);
+	gste_gamma_correct_alpha (pixels, WIDTH, HEIGHT, ROWSTRIDE, GAMMA);
+
+	/* also checks that color and padding bytes were left alone */
+	ok = TRUE;
+	for (i = 0; i < size; i++)
+	{
+		if (pixels[i] != expected[i])
+		{
+			g_print ("seed %u: byte %" G_GSIZE_FORMAT " (row %" G_GSIZE_FORMAT ", column %" G_GSIZE_FORMAT ") is %d, expected %d\n",
+			         seed, i, i / ROWSTRIDE, i % ROWSTRIDE, pixels[i], expected[i]);
+			ok = FALSE;
+			break;
+		}
+	}
+
+	g_free (pixels);
+	g_free (expected);
+
+	return ok;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+	guint32 seed;
+	int     failures;
+
+	failures = 0;
+
+	for (seed = 1; seed <= 16; seed++)
+	{
+		if (! test_gamma (seed))
+		{
+			failures++;
+		}
+	}
+
+	g_print ("%s\n", failures == 0 ? "ok" : "FAILED");
+
+	return failures == 0 ? 0 : 1;
+}
@@ -32,12 +32,39 @@
 
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <glib-unix.h>
 
 #include "gs-debug.h"
+#include "gs-profile-trace.h"
 
 static gboolean debugging = FALSE;
 static FILE    *debug_out = NULL;
 
+static void     gs_profile_init (void);
+
+/* number of activation timelines kept around */
+#define TIMELINE_HISTORY 8
+
+typedef struct
+{
+	/* monotonic time each stage was first reached, 0 if not reached */
+	gint64 stamps [GS_TIMELINE_N_STAGES];
+} GSTimeline;
+
+static GSTimeline timelines [TIMELINE_HISTORY];
+static guint      n_timelines = 0;
+
+static const char *timeline_stage_names [GS_TIMELINE_N_STAGES] =
+{
+	"idle-changed",
+	"listener-active",
+	"manager-activate",
+	"grab-root",
+	"windows-created",
+	"background-applied",
+	"job-started",
+};
+
 /* Based on rhythmbox/lib/rb-debug.c */
 /* Our own funky debugging function, should only be used when something
  * is not going wrong, if something *is* wrong use g_warning.
@@ -86,6 +113,8 @@ void
 gs_debug_init (gboolean debug,
                gboolean to_file)
 {
+	gs_profile_init ();
+
 	/* return if already initialized */
 	if (debugging == TRUE)
 	{
@@ -127,38 +156,267 @@ gs_debug_shutdown (void)
 	}
 }
 
+/* Each thread records into its own ring, so marks never contend.
+ * Rings are registered once and intentionally never freed so that a
+ * dump can still see the marks of threads that have exited.
+ */
+#define PROFILE_RING_SIZE 4096
+
+typedef struct
+{
+	gint64               time;
+	const GSProfileSite *site;
+	gint64               value;
+} GSProfileRecord;
+
+typedef struct
+{
+	GSProfileRecord records [PROFILE_RING_SIZE];
+	guint           head;
+	guint           tid;
+} GSProfileRing;
+
+gboolean       _gs_profile_enabled = FALSE;
+static GSList *profile_rings = NULL;
+static GMutex  profile_rings_lock;
+static GPrivate profile_ring_key = G_PRIVATE_INIT (NULL);
+
+static GSProfileRing *
+profile_ring_get (void)
+{
+	GSProfileRing *ring;
+	static guint   next_tid = 1;
+
+	ring = g_private_get (&profile_ring_key);
+	if (G_LIKELY (ring != NULL))
+	{
+		return ring;
+	}
+
+	ring = g_new0 (GSProfileRing, 1);
+
+	g_mutex_lock (&profile_rings_lock);
+	ring->tid = next_tid++;
+	profile_rings = g_slist_prepend (profile_rings, ring);
+	g_mutex_unlock (&profile_rings_lock);
+
+	g_private_set (&profile_ring_key, ring);
+
+	return ring;
+}
+
 void
-_gs_profile_log (const char *func,
-                 const char *note,
-                 const char *format,
-                 ...)
+_gs_profile_record (const GSProfileSite *site,
+                    gint64               value)
 {
-	va_list args;
-	char   *str;
-	char   *formatted;
+	GSProfileRing   *ring;
+	GSProfileRecord *record;
+	guint            head;
 
-	if (format == NULL)
+	ring = profile_ring_get ();
+	head = ring->head;
+
+	record = &ring->records [head % PROFILE_RING_SIZE];
+	record->time = g_get_monotonic_time ();
+	record->site = site;
+	record->value = value;
+
+	/* publish the record only once it is complete */
+	g_atomic_int_set (&ring->head, head + 1);
+}
+
+/* Returns the recorded marks in the Chrome trace event format, with
+ * monotonic timestamps so traces of the daemon, the dialog and the
+ * savers can be merged.
+ */
+char *
+gs_profile_dump (void)
+{
+	GString *str;
+	GSList  *l;
+
+	str = gs_profile_trace_new ();
+
+	g_mutex_lock (&profile_rings_lock);
+
+	for (l = profile_rings; l != NULL; l = l->next)
+	{
+		GSProfileRing *ring = l->data;
+		guint          head;
+		guint          first;
+		guint          n;
+		guint          i;
+
+		/* head counts every mark ever made, the ring keeps the last ones */
+		head = g_atomic_int_get (&ring->head);
+		n = MIN (head, PROFILE_RING_SIZE);
+		first = head - n;
+
+		for (i = 0; i < n; i++)
+		{
+			GSProfileRecord *record;
+
+			record = &ring->records [(first + i) % PROFILE_RING_SIZE];
+			gs_profile_trace_append (str, ring->tid, record->time,
+			                         record->site->func,
+			                         record->site->note,
+			                         record->site->label,
+			                         record->value);
+		}
+	}
+
+	g_mutex_unlock (&profile_rings_lock);
+
+	return gs_profile_trace_finish (str);
+}
+
+static gboolean
+profile_dump_cb (gpointer data)
+{
+	char   *contents;
+	char   *path;
+	GError *error;
+
+	contents = gs_profile_dump ();
+
+	error = NULL;
+	if (! gs_profile_trace_write (contents, &path, &error))
 	{
-		formatted = g_strdup ("");
+		g_warning ("Unable to write profile: %s", error->message);
+		g_error_free (error);
 	}
 	else
 	{
-		va_start (args, format);
-		formatted = g_strdup_vprintf (format, args);
-		va_end (args);
+		gs_debug ("Wrote profile to %s", path);
+	}
+
+	g_free (contents);
+	g_free (path);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+gs_profile_init (void)
+{
+	static gboolean initialized = FALSE;
+
+	if (initialized)
+	{
+		return;
 	}
+	initialized = TRUE;
 
-	if (func != NULL)
+	if (g_getenv ("MATE_SCREENSAVER_PROFILE") == NULL)
 	{
-		str = g_strdup_printf ("MARK: %s %s: %s %s", g_get_prgname(), func, note ? note : "", formatted);
+		return;
 	}
-	else
+
+	_gs_profile_enabled = TRUE;
+	g_unix_signal_add (SIGUSR1, profile_dump_cb, NULL);
+}
+
+static GSTimeline *
+timeline_nth (guint n)
+{
+	/* n == 0 is the most recent one */
+	if (n >= n_timelines || n >= TIMELINE_HISTORY)
+	{
+		return NULL;
+	}
+
+	return &timelines [(n_timelines - 1 - n) % TIMELINE_HISTORY];
+}
+
+static char *
+timeline_to_string (GSTimeline *timeline)
+{
+	GString *str;
+	gint64   start;
+	int      i;
+
+	str = g_string_new (NULL);
+	start = 0;
+
+	for (i = 0; i < GS_TIMELINE_N_STAGES; i++)
+	{
+		if (timeline->stamps [i] == 0)
+		{
+			continue;
+		}
+
+		if (start == 0)
+		{
+			start = timeline->stamps [i];
+		}
+
+		g_string_append_printf (str, "%s%s +%.1f ms",
+		                        str->len > 0 ? ", " : "",
+		                        timeline_stage_names [i],
+		                        (timeline->stamps [i] - start) / 1000.0);
+	}
+
+	return g_string_free (str, FALSE);
+}
+
+/* Records the time a stage of the activation was reached.  A new
+ * timeline is started when the session goes idle, or when the
+ * listener is activated outside of an ongoing activation (e.g. an
+ * explicit lock).  Only the first occurrence of each stage counts.
+ */
+void
+gs_timeline_mark (GSTimelineStage stage)
+{
+	GSTimeline *timeline;
+	gboolean    complete;
+
+	g_return_if_fail (stage < GS_TIMELINE_N_STAGES);
+
+	timeline = timeline_nth (0);
+	complete = (timeline == NULL || timeline->stamps [GS_TIMELINE_JOB_STARTED] != 0);
+
+	if (stage == GS_TIMELINE_IDLE_CHANGED
+	    || (stage == GS_TIMELINE_LISTENER_ACTIVE
+	        && (complete || timeline->stamps [stage] != 0)))
+	{
+		timeline = &timelines [n_timelines % TIMELINE_HISTORY];
+		memset (timeline, 0, sizeof (GSTimeline));
+		n_timelines++;
+		complete = FALSE;
+	}
+
+	if (complete || timeline->stamps [stage] != 0)
 	{
-		str = g_strdup_printf ("MARK: %s: %s %s", g_get_prgname(), note ? note : "", formatted);
+		return;
 	}
 
-	g_free (formatted);
+	timeline->stamps [stage] = g_get_monotonic_time ();
+
+	if (stage == GS_TIMELINE_JOB_STARTED && debugging)
+	{
+		char *str;
+
+		str = timeline_to_string (timeline);
+		gs_debug ("Activation timeline: %s", str);
+		g_free (str);
+	}
+}
+
+/* Returns the recorded timelines, most recent first */
+char **
+gs_timeline_dump (void)
+{
+	GPtrArray  *array;
+	GSTimeline *timeline;
+	guint       n;
+
+	array = g_ptr_array_new ();
+
+	for (n = 0; (timeline = timeline_nth (n)) != NULL; n++)
+	{
+		g_ptr_array_add (array, timeline_to_string (timeline));
+	}
+	g_ptr_array_add (array, NULL);
 
-	g_access (str, F_OK);
-	g_free (str);
+	return (char **) g_ptr_array_free (array, FALSE);
 }
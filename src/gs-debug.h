@@ -46,26 +46,53 @@ void gs_debug_real             (const char *func,
                                 int         line,
                                 const char *format, ...);
 
+/* A profiling mark, one static instance per call site */
+typedef struct
+{
+	const char *func;
+	const char *note;
+	const char *label;
+} GSProfileSite;
+
+/* set by gs_debug_init() when MATE_SCREENSAVER_PROFILE is set */
+extern gboolean _gs_profile_enabled;
+
 #ifdef ENABLE_PROFILING
-#ifdef G_HAVE_ISO_VARARGS
-#define gs_profile_start(...) _gs_profile_log (G_STRFUNC, "start", __VA_ARGS__)
-#define gs_profile_end(...)   _gs_profile_log (G_STRFUNC, "end", __VA_ARGS__)
-#define gs_profile_msg(...)   _gs_profile_log (NULL, NULL, __VA_ARGS__)
-#elif defined(G_HAVE_GNUC_VARARGS)
-#define gs_profile_start(format...) _gs_profile_log (G_STRFUNC, "start", format)
-#define gs_profile_end(format...)   _gs_profile_log (G_STRFUNC, "end", format)
-#define gs_profile_msg(format...)   _gs_profile_log (NULL, NULL, format)
-#endif
+#define _gs_profile_mark(note, label, value) G_STMT_START {                      \
+		static const GSProfileSite _gs_profile_site = { G_STRFUNC, note, label }; \
+		if (G_UNLIKELY (_gs_profile_enabled))                                     \
+			_gs_profile_record (&_gs_profile_site, (value));                  \
+	} G_STMT_END
+#define gs_profile_start(label)        _gs_profile_mark ("start", label, 0)
+#define gs_profile_end(label)          _gs_profile_mark ("end", label, 0)
+#define gs_profile_msg(label)          _gs_profile_mark (NULL, label, 0)
+#define gs_profile_value(label, value) _gs_profile_mark ("value", label, value)
 #else
-#define gs_profile_start(...)
-#define gs_profile_end(...)
-#define gs_profile_msg(...)
+#define gs_profile_start(label)
+#define gs_profile_end(label)
+#define gs_profile_msg(label)
+#define gs_profile_value(label, value)
 #endif
 
-void            _gs_profile_log    (const char *func,
-                                    const char *note,
-                                    const char *format,
-                                    ...) G_GNUC_PRINTF (3, 4);
+/* Stages of the path from idle to a running saver, in order */
+typedef enum
+{
+	GS_TIMELINE_IDLE_CHANGED,
+	GS_TIMELINE_LISTENER_ACTIVE,
+	GS_TIMELINE_MANAGER_ACTIVATE,
+	GS_TIMELINE_GRAB_ROOT,
+	GS_TIMELINE_WINDOWS_CREATED,
+	GS_TIMELINE_BACKGROUND_APPLIED,
+	GS_TIMELINE_JOB_STARTED,
+	GS_TIMELINE_N_STAGES
+} GSTimelineStage;
+
+void            gs_timeline_mark   (GSTimelineStage stage);
+char          **gs_timeline_dump   (void);
+
+void            _gs_profile_record (const GSProfileSite *site,
+                                    gint64               value);
+char           *gs_profile_dump    (void);
 
 G_END_DECLS
 
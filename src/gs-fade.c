@@ -39,6 +39,12 @@
 #include <gdk/gdkx.h>
 #include <gtk/gtk.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "gs-fade.h"
 #include "gs-debug.h"
 
@@ -58,14 +64,122 @@
 
 static void     gs_fade_finalize   (GObject        *object);
 
+struct GSFadeOverlay;
+
 struct GSGammaInfo
 {
 	int              size;
 	unsigned short  *r;
 	unsigned short  *g;
 	unsigned short  *b;
+	/* scaled ramps sent to the server, 3 * size entries (r, g, b),
+	   allocated once at setup time and reused for every fade step */
+	unsigned short  *scratch;
+	/* scale factor currently held in scratch */
+	guint            last_scale;
 };
 
+/* ramp scale factors are 16.16 fixed point */
+#define GAMMA_SCALE_ONE   65536
+#define GAMMA_SCALE_UNSET G_MAXUINT
+
+static void
+gamma_info_alloc_scratch (struct GSGammaInfo *gamma_info)
+{
+	g_free (gamma_info->scratch);
+	gamma_info->scratch = NULL;
+	gamma_info->last_scale = GAMMA_SCALE_UNSET;
+
+	if (gamma_info->size > 0)
+	{
+		gamma_info->scratch = g_new (unsigned short, 3 * gamma_info->size);
+	}
+}
+
+static guint
+gamma_ratio_to_scale (float ratio)
+{
+	if (ratio <= 0)
+	{
+		return 0;
+	}
+	if (ratio >= 1)
+	{
+		return GAMMA_SCALE_ONE;
+	}
+
+	return (guint) (ratio * GAMMA_SCALE_ONE + 0.5f);
+}
+
+/* dst[i] = src[i] * scale / 65536, with scale in [0, 65536] */
+static void
+gamma_scale_ramp (unsigned short       *dst,
+                  const unsigned short *src,
+                  int                   size,
+                  guint                 scale)
+{
+	int i = 0;
+
+	if (scale >= GAMMA_SCALE_ONE)
+	{
+		memcpy (dst, src, size * sizeof (unsigned short));
+		return;
+	}
+
+#if defined(__AVX2__)
+	{
+		const __m256i factor = _mm256_set1_epi16 ((short) scale);
+
+		for (; i + 16 <= size; i += 16)
+		{
+			__m256i v = _mm256_loadu_si256 ((const __m256i *) (src + i));
+			_mm256_storeu_si256 ((__m256i *) (dst + i), _mm256_mulhi_epu16 (v, factor));
+		}
+	}
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+	{
+		const __m128i factor = _mm_set1_epi16 ((short) scale);
+
+		for (; i + 8 <= size; i += 8)
+		{
+			__m128i v = _mm_loadu_si128 ((const __m128i *) (src + i));
+			_mm_storeu_si128 ((__m128i *) (dst + i), _mm_mulhi_epu16 (v, factor));
+		}
+	}
+#endif
+
+	for (; i < size; i++)
+	{
+		dst[i] = (unsigned short) (((guint32) src[i] * scale) >> 16);
+	}
+}
+
+/* fills the scratch buffer with the saved ramps scaled by ratio,
+   returns FALSE if it already held that ramp */
+static gboolean
+gamma_info_scale (struct GSGammaInfo *gamma_info,
+                  float               ratio)
+{
+	guint scale;
+	int   size;
+
+	size = gamma_info->size;
+	scale = gamma_ratio_to_scale (ratio);
+
+	if (scale == gamma_info->last_scale)
+	{
+		return FALSE;
+	}
+	gamma_info->last_scale = scale;
+
+	gamma_scale_ramp (gamma_info->scratch, gamma_info->r, size, scale);
+	gamma_scale_ramp (gamma_info->scratch + size, gamma_info->g, size, scale);
+	gamma_scale_ramp (gamma_info->scratch + 2 * size, gamma_info->b, size, scale);
+
+	return TRUE;
+}
+
 struct GSFadeScreenPrivate
 {
 	int                 fade_type;
@@ -74,6 +188,12 @@ struct GSFadeScreenPrivate
 	struct GSGammaInfo *info;
 	/* one per screen in theory */
 	MateRRScreen      *rrscreen;
+	/* the crtc configuration changed while the saved ramps
+	   were in use, drop them once the fade is reset */
+	gboolean            ramps_stale;
+	/* one per monitor in overlay mode */
+	GSList             *overlays;
+	gdouble             overlay_alpha;
 #ifdef HAVE_XF86VMODE_GAMMA
 	/* one per screen also */
 	XF86VidModeGamma    vmg;
@@ -88,16 +208,24 @@ struct GSFadePrivate
 {
 	guint            enabled : 1;
 	guint            active : 1;
+	guint            fading_in : 1;
 
 	guint            timeout;
 
-	guint            step;
-	guint            num_steps;
 	guint            timer_id;
 
-	gdouble          alpha_per_iter;
+	/* optional widget whose frame clock paces the fade */
+	GtkWidget       *widget;
+	guint            tick_id;
+
+	gint64           start_time;
+	gdouble          start_alpha;
+	gdouble          target_alpha;
 	gdouble          current_alpha;
 
+	/* number of steps taken by the last fade */
+	guint            n_steps;
+
 	struct GSFadeScreenPrivate screen_priv;
 };
 
@@ -113,8 +241,12 @@ enum
     FADE_TYPE_GAMMA_NUMBER,
     FADE_TYPE_GAMMA_RAMP,
     FADE_TYPE_XRANDR,
+    FADE_TYPE_OVERLAY,
 };
 
+/* used when there is no mapped widget to pace the fade */
+#define FADE_STEP_MSECS 16
+
 static guint         signals [LAST_SIGNAL] = { 0, };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GSFade, gs_fade, G_TYPE_OBJECT)
@@ -215,25 +347,20 @@ xf86_whack_gamma (int              screen,
 	{
 
 # ifdef HAVE_XF86VMODE_GAMMA_RAMP
-		unsigned short *r, *g, *b;
-		int i;
-
-		r = g_new0 (unsigned short, gamma_info->size);
-		g = g_new0 (unsigned short, gamma_info->size);
-		b = g_new0 (unsigned short, gamma_info->size);
+		int size = gamma_info->size;
 
-		for (i = 0; i < gamma_info->size; i++)
+		if (! gamma_info_scale (gamma_info, ratio))
 		{
-			r[i] = (unsigned short) (ratio * (float) gamma_info->r[i]);
-			g[i] = (unsigned short) (ratio * (float) gamma_info->g[i]);
-			b[i] = (unsigned short) (ratio * (float) gamma_info->b[i]);
+			/* the server already has this ramp */
+			return TRUE;
 		}
 
-		status = XF86VidModeSetGammaRamp (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()), screen, gamma_info->size, r, g, b);
-
-		g_free (r);
-		g_free (g);
-		g_free (b);
+		status = XF86VidModeSetGammaRamp (GDK_DISPLAY_XDISPLAY (gdk_display_get_default ()),
+		                                  screen,
+		                                  size,
+		                                  gamma_info->scratch,
+		                                  gamma_info->scratch + size,
+		                                  gamma_info->scratch + 2 * size);
 
 # else  /* !HAVE_XF86VMODE_GAMMA_RAMP */
 		abort ();
@@ -335,6 +462,8 @@ gamma_fade_setup (GSFade *fade)
 			screen_priv->fade_type = FADE_TYPE_GAMMA_NUMBER;
 			goto test_number;
 		}
+
+		gamma_info_alloc_scratch (screen_priv->info);
 		gs_debug ("Initialized gamma ramp fade");
 	}
 # endif /* HAVE_XF86VMODE_GAMMA_RAMP */
@@ -389,6 +518,7 @@ screen_fade_finish (GSFade *fade)
 			g_free (screen_priv->info[i].g);
 		if (screen_priv->info[i].b)
 			g_free (screen_priv->info[i].b);
+		g_free (screen_priv->info[i].scratch);
 	}
 
 	g_free (screen_priv->info);
@@ -461,6 +591,30 @@ fade_none:
 
 /* Xrandr support */
 
+/* checks the saved ramps still line up with the crtcs, this
+   only looks at client side state and makes no server request */
+static gboolean
+xrandr_ramps_match_crtcs (struct GSFadeScreenPrivate *screen_priv)
+{
+	MateRRCrtc **crtcs;
+	int          i;
+
+	crtcs = mate_rr_screen_list_crtcs (screen_priv->rrscreen);
+	for (i = 0; crtcs[i] != NULL; i++)
+	{
+		gboolean has_mode;
+
+		if (i >= screen_priv->num_ramps)
+			return FALSE;
+
+		has_mode = (mate_rr_crtc_get_current_mode (crtcs[i]) != NULL);
+		if (has_mode != (screen_priv->info[i].size > 0))
+			return FALSE;
+	}
+
+	return (i == screen_priv->num_ramps);
+}
+
 static gboolean xrandr_fade_setup (GSFade *fade)
 {
 	struct GSFadeScreenPrivate *screen_priv;
@@ -472,11 +626,16 @@ static gboolean xrandr_fade_setup (GSFade *fade)
 
 	screen_priv = &fade->priv->screen_priv;
 
+	/* the saved ramps are kept across fades and only
+	   dropped when the crtc configuration changes */
 	if (screen_priv->info)
-		return TRUE;
+	{
+		if (xrandr_ramps_match_crtcs (screen_priv))
+			return TRUE;
 
-	/* refresh the screen info */
-	mate_rr_screen_refresh (screen_priv->rrscreen, NULL);
+		gs_debug ("CRTC layout changed, reloading gamma ramps");
+		screen_fade_finish (fade);
+	}
 
 	crtcs = mate_rr_screen_list_crtcs (screen_priv->rrscreen);
 	while (*crtcs)
@@ -509,53 +668,82 @@ static gboolean xrandr_fade_setup (GSFade *fade)
 			res = mate_rr_crtc_get_gamma (crtc, &info->size,
 			                              &info->r, &info->g,
 			                              &info->b);
-			if (res == FALSE)
+			if (res == FALSE || info->size <= 0)
 				goto fail;
+
+			gamma_info_alloc_scratch (info);
 		}
 
 		crtcs++;
 		crtc_count++;
 	}
+	screen_priv->ramps_stale = FALSE;
 	return TRUE;
 fail:
+	screen_fade_finish (fade);
 	return FALSE;
 }
 
-static void xrandr_crtc_whack_gamma (MateRRCrtc *crtc,
-                                     struct GSGammaInfo *gamma_info,
-                                     float            ratio)
+static void
+xrandr_fade_finish (GSFade *fade)
 {
-	unsigned short *r, *g, *b;
-	int i;
+	struct GSFadeScreenPrivate *screen_priv;
 
-	if (gamma_info->size == 0)
+	screen_priv = &fade->priv->screen_priv;
+
+	/* keep the saved ramps for the next fade unless they are stale */
+	if (screen_priv->ramps_stale)
+	{
+		screen_fade_finish (fade);
+		screen_priv->ramps_stale = FALSE;
+	}
+}
+
+static void
+on_rrscreen_changed (MateRRScreen *rrscreen,
+                     GSFade       *fade)
+{
+	struct GSFadeScreenPrivate *screen_priv;
+
+	screen_priv = &fade->priv->screen_priv;
+
+	if (!screen_priv->info)
 		return;
 
-	if (ratio < 0)
+	if (fade->priv->active || fade->priv->current_alpha < 1.0)
 	{
-		ratio = 0;
+		/* still needed to restore the screen */
+		gs_debug ("RandR configuration changed during fade, gamma ramps are stale");
+		screen_priv->ramps_stale = TRUE;
 	}
-	if (ratio > 1)
+	else
 	{
-		ratio = 1;
+		gs_debug ("RandR configuration changed, dropping saved gamma ramps");
+		screen_fade_finish (fade);
 	}
+}
 
-	r = g_new0 (unsigned short, gamma_info->size);
-	g = g_new0 (unsigned short, gamma_info->size);
-	b = g_new0 (unsigned short, gamma_info->size);
+/* queues the gamma update for a crtc without flushing,
+   returns FALSE if the crtc ramp did not change */
+static gboolean xrandr_crtc_whack_gamma (MateRRCrtc *crtc,
+                                         struct GSGammaInfo *gamma_info,
+                                         float            ratio)
+{
+	int size;
 
-	for (i = 0; i < gamma_info->size; i++)
-	{
-		r[i] = (unsigned short) (ratio * (float) gamma_info->r[i]);
-		g[i] = (unsigned short) (ratio * (float) gamma_info->g[i]);
-		b[i] = (unsigned short) (ratio * (float) gamma_info->b[i]);
-	}
+	size = gamma_info->size;
+	if (size == 0 || gamma_info->scratch == NULL)
+		return FALSE;
+
+	if (! gamma_info_scale (gamma_info, ratio))
+		return FALSE;
+
+	mate_rr_crtc_set_gamma (crtc, size,
+	                        gamma_info->scratch,
+	                        gamma_info->scratch + size,
+	                        gamma_info->scratch + 2 * size);
 
-	mate_rr_crtc_set_gamma (crtc, gamma_info->size,
-	                        r, g, b);
-	g_free (r);
-	g_free (g);
-	g_free (b);
+	return TRUE;
 }
 
 static gboolean xrandr_fade_set_alpha_gamma (GSFade *fade,
@@ -564,6 +752,7 @@ static gboolean xrandr_fade_set_alpha_gamma (GSFade *fade,
 	struct GSFadeScreenPrivate *screen_priv;
 	struct GSGammaInfo *info;
 	MateRRCrtc **crtcs;
+	gboolean changed;
 	int i;
 
 	screen_priv = &fade->priv->screen_priv;
@@ -572,18 +761,59 @@ static gboolean xrandr_fade_set_alpha_gamma (GSFade *fade,
 		return FALSE;
 
 	crtcs = mate_rr_screen_list_crtcs (screen_priv->rrscreen);
+	changed = FALSE;
 	i = 0;
 
-	while (*crtcs)
+	/* queue the ramps of all crtcs and send them to the server
+	   in one batch so that the heads are updated together */
+	while (*crtcs && i < screen_priv->num_ramps)
 	{
 		info = &screen_priv->info[i];
-		xrandr_crtc_whack_gamma (*crtcs, info, alpha);
+		if (xrandr_crtc_whack_gamma (*crtcs, info, alpha))
+			changed = TRUE;
 		i++;
 		crtcs++;
 	}
+
+	if (changed)
+		gdk_display_flush (gdk_display_get_default ());
+
 	return TRUE;
 }
 
+/* virtual GPUs and Xvfb have RandR but no gamma ramps,
+   this needs a crtc in use with a ramp to fade */
+static gboolean
+xrandr_has_gamma (MateRRScreen *rrscreen)
+{
+	MateRRCrtc **crtcs;
+	gboolean     has_gamma = FALSE;
+
+	for (crtcs = mate_rr_screen_list_crtcs (rrscreen); *crtcs; crtcs++)
+	{
+		unsigned short *r = NULL;
+		unsigned short *g = NULL;
+		unsigned short *b = NULL;
+		int             size = 0;
+		gboolean        res;
+
+		if (!mate_rr_crtc_get_current_mode (*crtcs))
+			continue;
+
+		res = mate_rr_crtc_get_gamma (*crtcs, &size, &r, &g, &b);
+		g_free (r);
+		g_free (g);
+		g_free (b);
+
+		if (res == FALSE || size <= 0)
+			return FALSE;
+
+		has_gamma = TRUE;
+	}
+
+	return has_gamma;
+}
+
 static void
 check_randr_extension (GSFade *fade)
 {
@@ -593,9 +823,15 @@ check_randr_extension (GSFade *fade)
 
 	screen_priv = &fade->priv->screen_priv;
 
-	screen_priv->rrscreen = mate_rr_screen_new (screen,
-	                        NULL);
 	if (!screen_priv->rrscreen)
+	{
+		screen_priv->rrscreen = mate_rr_screen_new (screen,
+		                        NULL);
+		if (screen_priv->rrscreen)
+			g_signal_connect (screen_priv->rrscreen, "changed",
+			                  G_CALLBACK (on_rrscreen_changed), fade);
+	}
+	if (!screen_priv->rrscreen || !xrandr_has_gamma (screen_priv->rrscreen))
 	{
 		screen_priv->fade_type = FADE_TYPE_NONE;
 		return;
@@ -603,10 +839,241 @@ check_randr_extension (GSFade *fade)
 
 	screen_priv->fade_type = FADE_TYPE_XRANDR;
 	screen_priv->fade_setup = xrandr_fade_setup;
-	screen_priv->fade_finish = screen_fade_finish;
+	screen_priv->fade_finish = xrandr_fade_finish;
 	screen_priv->fade_set_alpha_gamma = xrandr_fade_set_alpha_gamma;
 }
 
+/* Overlay support, for servers without gamma control */
+
+struct GSFadeOverlay
+{
+	GSFade          *fade;
+	GtkWidget       *window;
+	/* copy of the screen below the overlay, only used when
+	   there is no compositing manager to blend the overlay */
+	cairo_surface_t *snapshot;
+};
+
+static gboolean
+overlay_draw_cb (GtkWidget            *widget,
+                 cairo_t              *cr,
+                 struct GSFadeOverlay *overlay)
+{
+	struct GSFadeScreenPrivate *screen_priv;
+
+	screen_priv = &overlay->fade->priv->screen_priv;
+
+	cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+
+	if (overlay->snapshot != NULL)
+	{
+		cairo_set_source_surface (cr, overlay->snapshot, 0, 0);
+		cairo_paint (cr);
+
+		cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+		cairo_set_source_rgba (cr, 0.0, 0.0, 0.0, 1.0 - screen_priv->overlay_alpha);
+	}
+	else
+	{
+		cairo_set_source_rgb (cr, 0.0, 0.0, 0.0);
+	}
+
+	cairo_paint (cr);
+
+	return TRUE;
+}
+
+static void
+overlay_free (struct GSFadeOverlay *overlay)
+{
+	if (overlay->window != NULL)
+	{
+		gtk_widget_destroy (overlay->window);
+	}
+
+	if (overlay->snapshot != NULL)
+	{
+		cairo_surface_destroy (overlay->snapshot);
+	}
+
+	g_free (overlay);
+}
+
+static struct GSFadeOverlay *
+overlay_new (GSFade     *fade,
+             GdkMonitor *monitor,
+             gboolean    composited)
+{
+	struct GSFadeOverlay *overlay;
+	GdkScreen            *screen;
+	GdkWindow            *gdk_window;
+	GdkPixbuf            *pixbuf;
+	GdkRectangle          rect;
+	cairo_region_t       *region;
+
+	screen = gdk_display_get_default_screen (gdk_monitor_get_display (monitor));
+	gdk_monitor_get_geometry (monitor, &rect);
+
+	pixbuf = NULL;
+	if (! composited)
+	{
+		pixbuf = gdk_pixbuf_get_from_window (gdk_screen_get_root_window (screen),
+		                                     rect.x, rect.y,
+		                                     rect.width, rect.height);
+		if (pixbuf == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	overlay = g_new0 (struct GSFadeOverlay, 1);
+	overlay->fade = fade;
+	overlay->window = gtk_window_new (GTK_WINDOW_POPUP);
+
+	if (composited)
+	{
+		GdkVisual *visual;
+
+		visual = gdk_screen_get_rgba_visual (screen);
+		if (visual != NULL)
+		{
+			gtk_widget_set_visual (overlay->window, visual);
+		}
+	}
+
+	gtk_widget_set_app_paintable (overlay->window, TRUE);
+	gtk_window_move (GTK_WINDOW (overlay->window), rect.x, rect.y);
+	gtk_window_set_default_size (GTK_WINDOW (overlay->window), rect.width, rect.height);
+	gtk_widget_realize (overlay->window);
+
+	gdk_window = gtk_widget_get_window (overlay->window);
+
+	if (pixbuf != NULL)
+	{
+		cairo_t *cr;
+
+		/* upload the snapshot once, fade steps then only
+		   blend on the server */
+		overlay->snapshot = gdk_window_create_similar_surface (gdk_window,
+		                                                       CAIRO_CONTENT_COLOR,
+		                                                       rect.width,
+		                                                       rect.height);
+		cr = cairo_create (overlay->snapshot);
+		gdk_cairo_set_source_pixbuf (cr, pixbuf, 0, 0);
+		cairo_paint (cr);
+		cairo_destroy (cr);
+
+		g_object_unref (pixbuf);
+	}
+	else
+	{
+		gtk_widget_set_opacity (overlay->window, 0.0);
+	}
+
+	/* let input through to the windows below */
+	region = cairo_region_create ();
+	gdk_window_input_shape_combine_region (gdk_window, region, 0, 0);
+	cairo_region_destroy (region);
+
+	g_signal_connect (overlay->window, "draw",
+	                  G_CALLBACK (overlay_draw_cb), overlay);
+
+	gtk_widget_show (overlay->window);
+
+	return overlay;
+}
+
+static gboolean
+overlay_fade_setup (GSFade *fade)
+{
+	struct GSFadeScreenPrivate *screen_priv;
+	struct GSFadeOverlay       *overlay;
+	GdkDisplay                 *display;
+	gboolean                    composited;
+	int                         n_monitors;
+	int                         i;
+
+	screen_priv = &fade->priv->screen_priv;
+
+	if (screen_priv->overlays)
+		return TRUE;
+
+	display = gdk_display_get_default ();
+	composited = gdk_screen_is_composited (gdk_display_get_default_screen (display));
+	n_monitors = gdk_display_get_n_monitors (display);
+
+	screen_priv->overlay_alpha = 1.0;
+
+	for (i = 0; i < n_monitors; i++)
+	{
+		overlay = overlay_new (fade, gdk_display_get_monitor (display, i), composited);
+		if (overlay != NULL)
+		{
+			screen_priv->overlays = g_slist_prepend (screen_priv->overlays, overlay);
+		}
+	}
+
+	gs_debug ("Initialized %s overlay fade",
+	          composited ? "composited" : "snapshot");
+
+	return (screen_priv->overlays != NULL);
+}
+
+static gboolean
+overlay_fade_set_alpha_gamma (GSFade *fade,
+                              gdouble alpha)
+{
+	struct GSFadeScreenPrivate *screen_priv;
+	GSList                     *l;
+
+	screen_priv = &fade->priv->screen_priv;
+
+	if (!screen_priv->overlays)
+		return FALSE;
+
+	screen_priv->overlay_alpha = CLAMP (alpha, 0.0, 1.0);
+
+	for (l = screen_priv->overlays; l; l = l->next)
+	{
+		struct GSFadeOverlay *overlay = l->data;
+
+		if (overlay->snapshot != NULL)
+		{
+			gtk_widget_queue_draw (overlay->window);
+		}
+		else
+		{
+			gtk_widget_set_opacity (overlay->window, 1.0 - screen_priv->overlay_alpha);
+		}
+	}
+
+	return TRUE;
+}
+
+static void
+overlay_fade_finish (GSFade *fade)
+{
+	struct GSFadeScreenPrivate *screen_priv;
+
+	screen_priv = &fade->priv->screen_priv;
+
+	g_slist_free_full (screen_priv->overlays, (GDestroyNotify) overlay_free);
+	screen_priv->overlays = NULL;
+}
+
+static void
+check_overlay_support (GSFade *fade)
+{
+	struct GSFadeScreenPrivate *screen_priv;
+
+	screen_priv = &fade->priv->screen_priv;
+
+	screen_priv->fade_type = FADE_TYPE_OVERLAY;
+	screen_priv->fade_setup = overlay_fade_setup;
+	screen_priv->fade_finish = overlay_fade_finish;
+	screen_priv->fade_set_alpha_gamma = overlay_fade_set_alpha_gamma;
+}
+
 static gboolean
 gs_fade_set_alpha (GSFade *fade,
                    gdouble alpha)
@@ -618,6 +1085,7 @@ gs_fade_set_alpha (GSFade *fade,
 	case FADE_TYPE_GAMMA_RAMP:
 	case FADE_TYPE_GAMMA_NUMBER:
 	case FADE_TYPE_XRANDR:
+	case FADE_TYPE_OVERLAY:
 		ret = fade->priv->screen_priv.fade_set_alpha_gamma (fade, alpha);
 		break;
 	case FADE_TYPE_NONE:
@@ -632,25 +1100,55 @@ gs_fade_set_alpha (GSFade *fade,
 	return ret;
 }
 
+/* smoothstep easing, maps [0, 1] onto [0, 1] */
+static gdouble
+fade_ease (gdouble t)
+{
+	return t * t * (3.0 - 2.0 * t);
+}
+
+/* moves current_alpha from start_alpha towards target_alpha */
 static gboolean
-gs_fade_out_iter (GSFade *fade)
+gs_fade_iter (GSFade *fade,
+              gint64  now)
 {
 	gboolean ret;
+	gdouble  t;
 
-	if (fade->priv->current_alpha < 0.01)
+	if (fade->priv->current_alpha == fade->priv->target_alpha)
 	{
 		return FALSE;
 	}
 
-	fade->priv->current_alpha -= fade->priv->alpha_per_iter;
+	t = 1.0;
+	if (fade->priv->timeout > 0)
+	{
+		t = (gdouble) (now - fade->priv->start_time) / (fade->priv->timeout * 1000.0);
+	}
+
+	if (t >= 1.0)
+	{
+		fade->priv->current_alpha = fade->priv->target_alpha;
+	}
+	else
+	{
+		fade->priv->current_alpha = fade->priv->start_alpha +
+		                            (fade->priv->target_alpha - fade->priv->start_alpha) * fade_ease (MAX (t, 0.0));
+	}
 
 	ret = gs_fade_set_alpha (fade, fade->priv->current_alpha);
+	if (ret)
+	{
+		fade->priv->n_steps++;
+	}
 
 	return ret;
 }
 
-static gboolean
-gs_fade_stop (GSFade *fade)
+static void fade_schedule (GSFade *fade);
+
+static void
+fade_unschedule (GSFade *fade)
 {
 	if (fade->priv->timer_id != 0)
 	{
@@ -658,7 +1156,21 @@ gs_fade_stop (GSFade *fade)
 		fade->priv->timer_id = 0;
 	}
 
-	fade->priv->step = 0;
+	if (fade->priv->tick_id != 0)
+	{
+		if (fade->priv->widget != NULL)
+		{
+			gtk_widget_remove_tick_callback (fade->priv->widget, fade->priv->tick_id);
+		}
+		fade->priv->tick_id = 0;
+	}
+}
+
+static gboolean
+gs_fade_stop (GSFade *fade)
+{
+	fade_unschedule (fade);
+
 	fade->priv->active = FALSE;
 
 	return TRUE;
@@ -674,6 +1186,13 @@ gs_fade_finish (GSFade *fade)
 		return;
 	}
 
+	if (fade->priv->fading_in)
+	{
+		/* jump to full brightness */
+		gs_fade_reset (fade);
+		return;
+	}
+
 	gs_fade_stop (fade);
 
 	g_signal_emit (fade, signals [FADED], 0);
@@ -682,11 +1201,12 @@ gs_fade_finish (GSFade *fade)
 }
 
 static gboolean
-fade_out_timer (GSFade *fade)
+fade_step (GSFade *fade,
+           gint64  now)
 {
 	gboolean res;
 
-	res = gs_fade_out_iter (fade);
+	res = gs_fade_iter (fade, now);
 
 	/* if failed then fade is complete */
 	if (! res)
@@ -698,6 +1218,121 @@ fade_out_timer (GSFade *fade)
 	return TRUE;
 }
 
+static gboolean
+fade_timer (GSFade *fade)
+{
+	if (! fade_step (fade, g_get_monotonic_time ()))
+	{
+		fade->priv->timer_id = 0;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+fade_tick (GtkWidget     *widget,
+               GdkFrameClock *frame_clock,
+               GSFade        *fade)
+{
+	if (! fade_step (fade, gdk_frame_clock_get_frame_time (frame_clock)))
+	{
+		fade->priv->tick_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+/* Steps are paced by the frame clock of the fade widget when it is
+   mapped, so no more gamma updates are sent than the display can show.
+   Otherwise a plain timeout is used.  Either way alpha only depends on
+   the time elapsed since the fade started. */
+static void
+fade_schedule (GSFade *fade)
+{
+	fade_unschedule (fade);
+
+	if (fade->priv->widget != NULL && gtk_widget_get_mapped (fade->priv->widget))
+	{
+		fade->priv->tick_id = gtk_widget_add_tick_callback (fade->priv->widget,
+		                                                    (GtkTickCallback) fade_tick,
+		                                                    fade,
+		                                                    NULL);
+	}
+	else
+	{
+		fade->priv->timer_id = g_timeout_add (FADE_STEP_MSECS,
+		                                      (GSourceFunc) fade_timer,
+		                                      fade);
+	}
+}
+
+static void
+widget_unmap_cb (GtkWidget *widget,
+                 GSFade    *fade)
+{
+	/* the frame clock stops ticking for unmapped widgets */
+	if (fade->priv->tick_id != 0)
+	{
+		gs_debug ("Fade widget unmapped, falling back to timer");
+		fade_schedule (fade);
+	}
+}
+
+static void
+widget_map_cb (GtkWidget *widget,
+               GSFade    *fade)
+{
+	if (fade->priv->timer_id != 0)
+	{
+		fade_schedule (fade);
+	}
+}
+
+void
+gs_fade_set_widget (GSFade    *fade,
+                    GtkWidget *widget)
+{
+	gboolean scheduled;
+
+	g_return_if_fail (GS_IS_FADE (fade));
+	g_return_if_fail (widget == NULL || GTK_IS_WIDGET (widget));
+
+	if (fade->priv->widget == widget)
+	{
+		return;
+	}
+
+	scheduled = (fade->priv->timer_id != 0 || fade->priv->tick_id != 0);
+	fade_unschedule (fade);
+
+	if (fade->priv->widget != NULL)
+	{
+		g_signal_handlers_disconnect_by_func (fade->priv->widget, widget_unmap_cb, fade);
+		g_signal_handlers_disconnect_by_func (fade->priv->widget, widget_map_cb, fade);
+		g_object_remove_weak_pointer (G_OBJECT (fade->priv->widget),
+		                              (gpointer *) &fade->priv->widget);
+	}
+
+	fade->priv->widget = widget;
+
+	if (fade->priv->widget != NULL)
+	{
+		g_object_add_weak_pointer (G_OBJECT (fade->priv->widget),
+		                           (gpointer *) &fade->priv->widget);
+		g_signal_connect (fade->priv->widget, "unmap",
+		                  G_CALLBACK (widget_unmap_cb), fade);
+		g_signal_connect_after (fade->priv->widget, "map",
+		                        G_CALLBACK (widget_map_cb), fade);
+	}
+
+	if (scheduled)
+	{
+		fade_schedule (fade);
+	}
+}
+
 gboolean
 gs_fade_get_active (GSFade *fade)
 {
@@ -715,32 +1350,58 @@ gs_fade_set_timeout (GSFade   *fade,
 	fade->priv->timeout = timeout;
 }
 
+/* the gamma backends can still fail once a fade starts,
+   for example when the server reports ramps it cannot read,
+   the overlay is used from then on */
+static gboolean
+fade_setup_with_fallback (GSFade *fade)
+{
+	struct GSFadeScreenPrivate *screen_priv;
+	int                         fade_type;
+
+	screen_priv = &fade->priv->screen_priv;
+	fade_type = screen_priv->fade_type;
+
+	if (fade_type == FADE_TYPE_NONE)
+		return TRUE;
+
+	if (screen_priv->fade_setup (fade))
+		return TRUE;
+
+	if (fade_type == FADE_TYPE_OVERLAY)
+		return FALSE;
+
+	gs_debug ("Gamma fade setup failed, falling back to the overlay");
+
+	screen_fade_finish (fade);
+	check_overlay_support (fade);
+
+	return screen_priv->fade_setup (fade);
+}
+
 static void
 gs_fade_start (GSFade *fade,
                guint   timeout)
 {
 	g_return_if_fail (GS_IS_FADE (fade));
 
-	if ((fade->priv->screen_priv.fade_type != FADE_TYPE_NONE) &&
-	    (fade->priv->screen_priv.fade_setup (fade) == FALSE))
+	if (! fade_setup_with_fallback (fade))
 		return;
 
-	if (fade->priv->timer_id != 0)
+	if (fade->priv->timer_id != 0 || fade->priv->tick_id != 0)
 		gs_fade_stop (fade);
 
 	fade->priv->active = TRUE;
+	fade->priv->fading_in = FALSE;
 	gs_fade_set_timeout (fade, timeout);
 
 	if (fade->priv->screen_priv.fade_type != FADE_TYPE_NONE)
 	{
-		double steps_per_sec = 60.0;
-		double msecs_per_step = 1000.0 / steps_per_sec;
-		double num_steps = ((double) fade->priv->timeout) / msecs_per_step;
-
-		fade->priv->alpha_per_iter = 1.0 / num_steps;
-		fade->priv->timer_id = g_timeout_add ((guint) msecs_per_step,
-		                                      (GSourceFunc) fade_out_timer,
-		                                      fade);
+		fade->priv->start_time = g_get_monotonic_time ();
+		fade->priv->start_alpha = fade->priv->current_alpha;
+		fade->priv->target_alpha = 0.0;
+		fade->priv->n_steps = 0;
+		fade_schedule (fade);
 	}
 	else
 	{
@@ -848,6 +1509,7 @@ gs_fade_reset (GSFade *fade)
 		gs_fade_stop (fade);
 	}
 
+	fade->priv->fading_in = FALSE;
 	fade->priv->current_alpha = 1.0;
 
 	gs_fade_set_alpha (fade, fade->priv->current_alpha);
@@ -856,6 +1518,118 @@ gs_fade_reset (GSFade *fade)
 		fade->priv->screen_priv.fade_finish (fade);
 }
 
+/* Fades back in from the current alpha.  timeout is the duration of a
+   fade in from black, partial fades take proportionally less.  A fade
+   out started meanwhile continues from wherever the fade in got to,
+   reusing the saved ramps. */
+void
+gs_fade_unfade (GSFade *fade,
+                guint   timeout)
+{
+	g_return_if_fail (GS_IS_FADE (fade));
+
+	if (fade->priv->screen_priv.fade_type == FADE_TYPE_NONE
+	        || fade->priv->current_alpha >= 1.0
+	        || timeout == 0)
+	{
+		gs_fade_reset (fade);
+		return;
+	}
+
+	if (fade->priv->active && fade->priv->fading_in)
+	{
+		/* already on its way */
+		return;
+	}
+
+	gs_debug ("Fading in from %f", fade->priv->current_alpha);
+
+	if (fade->priv->active)
+	{
+		gs_fade_stop (fade);
+	}
+
+	fade->priv->active = TRUE;
+	fade->priv->fading_in = TRUE;
+	gs_fade_set_timeout (fade, (guint) (timeout * (1.0 - fade->priv->current_alpha)));
+
+	fade->priv->start_time = g_get_monotonic_time ();
+	fade->priv->start_alpha = fade->priv->current_alpha;
+	fade->priv->target_alpha = 1.0;
+	fade->priv->n_steps = 0;
+	fade_schedule (fade);
+}
+
+guint
+gs_fade_get_n_steps (GSFade *fade)
+{
+	g_return_val_if_fail (GS_IS_FADE (fade), 0);
+
+	return fade->priv->n_steps;
+}
+
+const char *
+gs_fade_get_backend (GSFade *fade)
+{
+	g_return_val_if_fail (GS_IS_FADE (fade), NULL);
+
+	switch (fade->priv->screen_priv.fade_type)
+	{
+	case FADE_TYPE_GAMMA_NUMBER:
+	case FADE_TYPE_GAMMA_RAMP:
+		return "gamma";
+	case FADE_TYPE_XRANDR:
+		return "xrandr";
+	case FADE_TYPE_OVERLAY:
+		return "overlay";
+	default:
+		return "none";
+	}
+}
+
+/* Forces a fade backend, one of "xrandr", "gamma", "overlay" or
+   "none".  Returns FALSE if the backend is not available. */
+gboolean
+gs_fade_set_backend (GSFade     *fade,
+                     const char *backend)
+{
+	struct GSFadeScreenPrivate *screen_priv;
+
+	g_return_val_if_fail (GS_IS_FADE (fade), FALSE);
+	g_return_val_if_fail (backend != NULL, FALSE);
+
+	screen_priv = &fade->priv->screen_priv;
+
+	gs_fade_reset (fade);
+	screen_fade_finish (fade);
+
+	screen_priv->fade_type = FADE_TYPE_NONE;
+	screen_priv->fade_setup = NULL;
+	screen_priv->fade_set_alpha_gamma = NULL;
+	screen_priv->fade_finish = NULL;
+
+	if (strcmp (backend, "xrandr") == 0)
+	{
+		check_randr_extension (fade);
+	}
+	else if (strcmp (backend, "gamma") == 0)
+	{
+		check_gamma_extension (fade);
+	}
+	else if (strcmp (backend, "overlay") == 0)
+	{
+		check_overlay_support (fade);
+	}
+	else if (strcmp (backend, "none") != 0)
+	{
+		g_warning ("Unknown fade backend: %s", backend);
+	}
+
+	gs_debug ("Fade type: %d", screen_priv->fade_type);
+
+	return (strcmp (backend, gs_fade_get_backend (fade)) == 0);
+}
+
 static void
 gs_fade_class_init (GSFadeClass *klass)
 {
@@ -886,6 +1660,8 @@ gs_fade_init (GSFade *fade)
 	check_randr_extension (fade);
 	if (!fade->priv->screen_priv.fade_type)
 		check_gamma_extension (fade);
+	if (!fade->priv->screen_priv.fade_type)
+		check_overlay_support (fade);
 	gs_debug ("Fade type: %d", fade->priv->screen_priv.fade_type);
 }
 
@@ -901,10 +1677,18 @@ gs_fade_finalize (GObject *object)
 
 	g_return_if_fail (fade->priv != NULL);
 
-	fade->priv->screen_priv.fade_finish(fade);
+	gs_fade_set_widget (fade, NULL);
+
+	if (fade->priv->screen_priv.fade_finish)
+		fade->priv->screen_priv.fade_finish (fade);
+	screen_fade_finish (fade);
 
 	if (fade->priv->screen_priv.rrscreen)
+	{
+		g_signal_handlers_disconnect_by_func (fade->priv->screen_priv.rrscreen,
+		                                      on_rrscreen_changed, fade);
 		g_object_unref (fade->priv->screen_priv.rrscreen);
+	}
 	fade->priv->screen_priv.rrscreen = NULL;
 
 	G_OBJECT_CLASS (gs_fade_parent_class)->finalize (object);
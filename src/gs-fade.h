@@ -25,6 +25,7 @@
 #define __GS_FADE_H
 
 #include <glib.h>
+#include <gtk/gtk.h>
 
 G_BEGIN_DECLS
 
@@ -68,9 +69,19 @@ void        gs_fade_sync             (GSFade        *fade,
 
 void        gs_fade_finish           (GSFade    *fade);
 void        gs_fade_reset            (GSFade    *fade);
+void        gs_fade_unfade           (GSFade    *fade,
+                                      guint      timeout);
 
 gboolean    gs_fade_get_active       (GSFade    *fade);
 
+void        gs_fade_set_widget       (GSFade    *fade,
+                                      GtkWidget *widget);
+
+const char *gs_fade_get_backend      (GSFade     *fade);
+gboolean    gs_fade_set_backend      (GSFade     *fade,
+                                      const char *backend);
+guint       gs_fade_get_n_steps      (GSFade    *fade);
+
 gboolean    gs_fade_get_enabled      (GSFade    *fade);
 void        gs_fade_set_enabled      (GSFade    *fade,
                                       gboolean   enabled);
@@ -38,6 +38,12 @@ static void     gs_grab_finalize   (GObject     *object);
 
 static gpointer grab_object = NULL;
 
+/* delay before the first retry of a contested grab, doubled each time */
+#define GRAB_RETRY_MIN_MSECS 10
+#define GRAB_RETRY_MAX_MSECS 1000
+/* give up after this long, and nuke the focus half way through */
+#define GRAB_TIMEOUT_MSECS   12000
+
 struct GSGrabPrivate
 {
 	GdkWindow  *grab_window;
@@ -46,6 +52,18 @@ struct GSGrabPrivate
 	guint       hide_cursor : 1;
 
 	GtkWidget *invisible;
+
+	/* pending asynchronous grab */
+	GdkWindow      *pending_window;
+	GdkDisplay     *pending_display;
+	guint           pending_no_pointer_grab : 1;
+	guint           pending_hide_cursor : 1;
+	guint           focus_nuked : 1;
+	guint           retry_id;
+	guint           retry_msecs;
+	gint64          start_time;
+	GSGrabDoneFunc  done_cb;
+	gpointer        done_data;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GSGrab, gs_grab, G_TYPE_OBJECT)
@@ -286,59 +304,162 @@ gs_grab_nuke_focus (GdkDisplay *display)
 	gdk_x11_display_error_trap_pop_ignored (display);
 }
 
-gboolean
-gs_grab_grab_window (GSGrab     *grab,
-                     GdkWindow  *window,
-                     GdkDisplay *display,
-                     gboolean    no_pointer_grab,
-                     gboolean    hide_cursor)
+static void
+grab_pending_clear (GSGrab *grab)
 {
-	gboolean    status = FALSE;
-	int         i;
-	int         retries = 12;
+	if (grab->priv->retry_id != 0)
+	{
+		g_source_remove (grab->priv->retry_id);
+		grab->priv->retry_id = 0;
+	}
 
-	for (i = 0; i < retries; i++)
+	if (grab->priv->pending_window != NULL)
 	{
-		status = gs_grab_get (grab, window, display,
-		                      no_pointer_grab, hide_cursor);
-		if (status == GDK_GRAB_SUCCESS)
-		{
-			break;
-		}
-		else if (i == (int) (retries / 2))
-		{
-			/* try nuking focus in the middle */
-			gs_grab_nuke_focus (display);
-		}
+		g_object_unref (grab->priv->pending_window);
+		grab->priv->pending_window = NULL;
+	}
 
-		/* else, wait a second and try to grab again */
-		g_usleep (G_USEC_PER_SEC);
+	grab->priv->pending_display = NULL;
+	grab->priv->done_cb = NULL;
+	grab->priv->done_data = NULL;
+}
+
+static void
+grab_pending_done (GSGrab  *grab,
+                   gboolean grabbed)
+{
+	GSGrabDoneFunc done_cb;
+	gpointer       done_data;
+
+	done_cb = grab->priv->done_cb;
+	done_data = grab->priv->done_data;
+
+	grab_pending_clear (grab);
+
+	if (done_cb != NULL)
+	{
+		done_cb (grab, grabbed, done_data);
 	}
+}
 
-	if (status != GDK_GRAB_SUCCESS)
+static gboolean
+grab_retry (GSGrab *grab)
+{
+	int    status;
+	gint64 elapsed;
+
+	status = gs_grab_get (grab,
+	                      grab->priv->pending_window,
+	                      grab->priv->pending_display,
+	                      grab->priv->pending_no_pointer_grab,
+	                      grab->priv->pending_hide_cursor);
+	if (status == GDK_GRAB_SUCCESS)
+	{
+		grab->priv->retry_id = 0;
+		grab_pending_done (grab, TRUE);
+		return FALSE;
+	}
+
+	elapsed = (g_get_monotonic_time () - grab->priv->start_time) / 1000;
+
+	if (elapsed >= GRAB_TIMEOUT_MSECS)
 	{
 		gs_debug ("Couldn't grab devices!  (%s)",
 		          grab_string (status));
 
 		/* do not blank without a devices grab */
+		grab->priv->retry_id = 0;
+		grab_pending_done (grab, FALSE);
 		return FALSE;
 	}
 
-	/* grab is good, go ahead and blank  */
-	return TRUE;
+	if (! grab->priv->focus_nuked && elapsed >= GRAB_TIMEOUT_MSECS / 2)
+	{
+		/* try nuking focus in the middle */
+		gs_grab_nuke_focus (grab->priv->pending_display);
+		grab->priv->focus_nuked = TRUE;
+	}
+
+	gs_debug ("Grab failed (%s), retrying in %u ms",
+	          grab_string (status), grab->priv->retry_msecs);
+
+	grab->priv->retry_id = g_timeout_add (grab->priv->retry_msecs,
+	                                      (GSourceFunc) grab_retry,
+	                                      grab);
+	grab->priv->retry_msecs = MIN (grab->priv->retry_msecs * 2,
+	                               GRAB_RETRY_MAX_MSECS);
+
+	return FALSE;
+}
+
+/* Grabs the devices to window without blocking the main loop.  The
+ * first attempt is made right away and done_cb may be called before
+ * this returns.  A contested grab is retried with an increasing delay
+ * until it succeeds or times out.  Only one grab can be pending, a
+ * new one cancels the previous without calling its callback.
+ */
+void
+gs_grab_grab_window_async (GSGrab        *grab,
+                           GdkWindow     *window,
+                           GdkDisplay    *display,
+                           gboolean       no_pointer_grab,
+                           gboolean       hide_cursor,
+                           GSGrabDoneFunc done_cb,
+                           gpointer       data)
+{
+	g_return_if_fail (GS_IS_GRAB (grab));
+	g_return_if_fail (GDK_IS_WINDOW (window));
+	g_return_if_fail (GDK_IS_DISPLAY (display));
+
+	gs_grab_cancel (grab);
+
+	grab->priv->pending_window = g_object_ref (window);
+	grab->priv->pending_display = display;
+	grab->priv->pending_no_pointer_grab = (no_pointer_grab != FALSE);
+	grab->priv->pending_hide_cursor = (hide_cursor != FALSE);
+	grab->priv->focus_nuked = FALSE;
+	grab->priv->retry_msecs = GRAB_RETRY_MIN_MSECS;
+	grab->priv->start_time = g_get_monotonic_time ();
+	grab->priv->done_cb = done_cb;
+	grab->priv->done_data = data;
+
+	grab_retry (grab);
+}
+
+/* Stops a pending grab, its callback is not called */
+void
+gs_grab_cancel (GSGrab *grab)
+{
+	g_return_if_fail (GS_IS_GRAB (grab));
+
+	if (grab->priv->pending_window != NULL)
+	{
+		gs_debug ("Cancelling pending grab");
+	}
+
+	grab_pending_clear (grab);
 }
 
-/* this is used to grab devices to the root */
 gboolean
-gs_grab_grab_root (GSGrab  *grab,
-                   gboolean no_pointer_grab,
-                   gboolean hide_cursor)
+gs_grab_is_pending (GSGrab *grab)
+{
+	g_return_val_if_fail (GS_IS_GRAB (grab), FALSE);
+
+	return (grab->priv->pending_window != NULL);
+}
+
+/* this is used to grab devices to the root */
+void
+gs_grab_grab_root_async (GSGrab        *grab,
+                         gboolean       no_pointer_grab,
+                         gboolean       hide_cursor,
+                         GSGrabDoneFunc done_cb,
+                         gpointer       data)
 {
 	GdkDisplay *display;
 	GdkWindow  *root;
 	GdkScreen  *screen;
 	GdkDevice  *device;
-	gboolean    res;
 
 	gs_debug ("Grabbing the root window");
 
@@ -347,35 +468,35 @@ gs_grab_grab_root (GSGrab  *grab,
 	gdk_device_get_position (device, &screen, NULL, NULL);
 	root = gdk_screen_get_root_window (screen);
 
-	res = gs_grab_grab_window (grab, root, display,
-	                           no_pointer_grab, hide_cursor);
-
-	return res;
+	gs_grab_grab_window_async (grab, root, display,
+	                           no_pointer_grab, hide_cursor,
+	                           done_cb, data);
 }
 
 /* this is used to grab devices to an offscreen window */
-gboolean
-gs_grab_grab_offscreen (GSGrab *grab,
-                        gboolean no_pointer_grab,
-                        gboolean hide_cursor)
+void
+gs_grab_grab_offscreen_async (GSGrab        *grab,
+                              gboolean       no_pointer_grab,
+                              gboolean       hide_cursor,
+                              GSGrabDoneFunc done_cb,
+                              gpointer       data)
 {
 	GdkWindow *window;
 	GdkDisplay *display;
 	GdkScreen  *screen;
-	gboolean    res;
 
 	gs_debug ("Grabbing an offscreen window");
 
 	window = gtk_widget_get_window (GTK_WIDGET (grab->priv->invisible));
 	screen = gtk_invisible_get_screen (GTK_INVISIBLE (grab->priv->invisible));
 	display = gdk_screen_get_display (screen);
-	res = gs_grab_grab_window (grab, window, display,
-	                           no_pointer_grab, hide_cursor);
 
-	return res;
+	gs_grab_grab_window_async (grab, window, display,
+	                           no_pointer_grab, hide_cursor,
+	                           done_cb, data);
 }
 
-/* this is similar to gs_grab_grab_window but doesn't fail */
+/* this is similar to gs_grab_grab_window_async but doesn't fail */
 void
 gs_grab_move_to_window (GSGrab     *grab,
                         GdkWindow  *window,
@@ -428,6 +549,8 @@ gs_grab_finalize (GObject *object)
 
 	g_return_if_fail (grab->priv != NULL);
 
+	grab_pending_clear (grab);
+
 	gtk_widget_destroy (grab->priv->invisible);
 
 	G_OBJECT_CLASS (gs_grab_parent_class)->finalize (object);
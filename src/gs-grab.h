@@ -50,6 +50,10 @@ typedef struct
 
 } GSGrabClass;
 
+typedef void  (* GSGrabDoneFunc) (GSGrab  *grab,
+                                  gboolean grabbed,
+                                  gpointer data);
+
 GType     gs_grab_get_type         (void);
 
 GSGrab  * gs_grab_new              (void);
@@ -57,18 +61,27 @@ GSGrab  * gs_grab_new              (void);
 void      gs_grab_release          (GSGrab    *grab,
                                     gboolean   flush);
 
-gboolean  gs_grab_grab_window      (GSGrab     *grab,
-                                    GdkWindow  *window,
-                                    GdkDisplay *display,
-                                    gboolean    no_pointer_grab,
-                                    gboolean    hide_cursor);
-
-gboolean  gs_grab_grab_root        (GSGrab    *grab,
-                                    gboolean   no_pointer_grab,
-                                    gboolean   hide_cursor);
-gboolean  gs_grab_grab_offscreen   (GSGrab    *grab,
-                                    gboolean   no_pointer_grab,
-                                    gboolean   hide_cursor);
+void      gs_grab_grab_window_async    (GSGrab        *grab,
+                                        GdkWindow     *window,
+                                        GdkDisplay    *display,
+                                        gboolean       no_pointer_grab,
+                                        gboolean       hide_cursor,
+                                        GSGrabDoneFunc done_cb,
+                                        gpointer       data);
+
+void      gs_grab_grab_root_async      (GSGrab        *grab,
+                                        gboolean       no_pointer_grab,
+                                        gboolean       hide_cursor,
+                                        GSGrabDoneFunc done_cb,
+                                        gpointer       data);
+void      gs_grab_grab_offscreen_async (GSGrab        *grab,
+                                        gboolean       no_pointer_grab,
+                                        gboolean       hide_cursor,
+                                        GSGrabDoneFunc done_cb,
+                                        gpointer       data);
+
+void      gs_grab_cancel           (GSGrab     *grab);
+gboolean  gs_grab_is_pending       (GSGrab     *grab);
 
 void      gs_grab_move_to_window   (GSGrab     *grab,
                                     GdkWindow  *window,
@@ -66,6 +66,11 @@ struct GSJobPrivate
 	guint           watch_id;
 
 	char           *command;
+
+	/* which of how many monitors the job draws on, passed to the
+	 * theme so that they can share the work */
+	int             monitor_index;
+	int             n_monitors;
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GSJob, gs_job, G_TYPE_OBJECT)
@@ -208,6 +213,59 @@ gs_job_set_command  (GSJob      *job,
 	return TRUE;
 }
 
+/* only the slideshow splits its work between the monitors */
+static gboolean
+command_shares_monitors (const char *command)
+{
+	char   **argv = NULL;
+	char    *name;
+	gboolean ret;
+
+	if (command == NULL || ! g_shell_parse_argv (command, NULL, &argv, NULL))
+	{
+		return FALSE;
+	}
+
+	name = g_path_get_basename (argv[0]);
+	ret = (strcmp (name, "slideshow") == 0);
+
+	g_free (name);
+	g_strfreev (argv);
+
+	return ret;
+}
+
+/* Tells the theme it is one of n_monitors jobs running at once, the
+   one on monitor monitor_index. A running theme that splits its work
+   is restarted when its share changes. */
+void
+gs_job_set_monitor (GSJob *job,
+                    int    monitor_index,
+                    int    n_monitors)
+{
+	g_return_if_fail (GS_IS_JOB (job));
+	g_return_if_fail (monitor_index >= 0 && monitor_index < n_monitors);
+
+	if (job->priv->monitor_index == monitor_index
+	        && job->priv->n_monitors == n_monitors)
+	{
+		return;
+	}
+
+	job->priv->monitor_index = monitor_index;
+	job->priv->n_monitors = n_monitors;
+
+	/* restart job */
+	if (gs_job_is_running (job)
+	        && command_shares_monitors (job->priv->command))
+	{
+		gs_debug ("Restarting job for monitor %d of %d",
+		          monitor_index, n_monitors);
+		gs_job_stop (job);
+		gs_job_start (job);
+	}
+}
+
 GSJob *
 gs_job_new (void)
 {
@@ -254,8 +312,9 @@ nice_process (int pid,
 }
 
 static GPtrArray *
-get_env_vars (GtkWidget *widget)
+get_env_vars (GSJob *job)
 {
+	GtkWidget   *widget = job->priv->widget;
 	GPtrArray   *env;
 	const gchar *display_name;
 	gchar       *str;
@@ -297,13 +356,21 @@ get_env_vars (GtkWidget *widget)
 	g_ptr_array_add (env, g_strdup_printf ("XSCREENSAVER_WINDOW=%s", str));
 	g_free (str);
 
+	if (job->priv->n_monitors > 0)
+	{
+		g_ptr_array_add (env, g_strdup_printf ("MATE_SCREENSAVER_MONITOR=%d",
+		                                       job->priv->monitor_index));
+		g_ptr_array_add (env, g_strdup_printf ("MATE_SCREENSAVER_N_MONITORS=%d",
+		                                       job->priv->n_monitors));
+	}
+
 	g_ptr_array_add (env, NULL);
 
 	return env;
 }
 
 static gboolean
-spawn_on_widget (GtkWidget  *widget,
+spawn_on_widget (GSJob      *job,
                  const char *command,
                  int        *pid,
                  GIOFunc     watch_func,
@@ -332,7 +399,7 @@ spawn_on_widget (GtkWidget  *widget,
 		return FALSE;
 	}
 
-	env = get_env_vars (widget);
+	env = get_env_vars (job);
 
 	error = NULL;
 	result = g_spawn_async_with_pipes (NULL,
@@ -534,7 +601,7 @@ gs_job_start (GSJob *job)
 
 	const char *command_to_run = final_command ? final_command : job->priv->command;
 
-	result = spawn_on_widget (job->priv->widget,
+	result = spawn_on_widget (job,
 	                          command_to_run,
 	                          &job->priv->pid,
 	                          (GIOFunc)command_watch,
@@ -546,6 +613,7 @@ gs_job_start (GSJob *job)
 	if (result)
 	{
 		job->priv->status = GS_JOB_RUNNING;
+		gs_timeline_mark (GS_TIMELINE_JOB_STARTED);
 	}
 
 	return result;
@@ -64,6 +64,9 @@ void            gs_job_set_widget                (GSJob      *job,
 
 gboolean        gs_job_set_command               (GSJob          *job,
         const char     *command);
+void            gs_job_set_monitor               (GSJob          *job,
+        int             monitor_index,
+        int             n_monitors);
 
 G_END_DECLS
 
@@ -51,6 +51,11 @@ static DBusHandlerResult gs_listener_message_handler    (DBusConnection  *connec
         DBusMessage     *message,
         void            *user_data);
 
+static void              raise_error                    (DBusConnection  *connection,
+        DBusMessage     *in_reply_to,
+        const char      *error_name,
+        char            *format, ...);
+
 #define GS_LISTENER_SERVICE   "org.mate.ScreenSaver"
 #define GS_LISTENER_PATH      "/org/mate/ScreenSaver"
 #define GS_LISTENER_INTERFACE "org.mate.ScreenSaver"
@@ -79,6 +84,7 @@ static DBusHandlerResult gs_listener_message_handler    (DBusConnection  *connec
 #define SESSION_INTERFACE    "org.gnome.SessionManager"
 
 #define TYPE_MISMATCH_ERROR GS_LISTENER_INTERFACE ".TypeMismatch"
+#define ACTIVATION_FAILED_ERROR GS_LISTENER_INTERFACE ".ActivationFailed"
 
 struct GSListenerPrivate
 {
@@ -87,10 +93,14 @@ struct GSListenerPrivate
 
 	guint           session_idle : 1;
 	guint           active : 1;
+	/* the screen is not covered yet, see gs_listener_activation_finished */
+	guint           activating : 1;
 	guint           activation_enabled : 1;
 	guint           throttled : 1;
 	GHashTable     *inhibitors;
 	GHashTable     *throttlers;
+	/* Lock and SetActive calls answered once the activation finishes */
+	GSList         *activation_replies;
 	time_t          active_start;
 	time_t          session_idle_start;
 	char           *session_id;
@@ -435,6 +445,86 @@ listener_set_active_internal (GSListener *listener,
 	return TRUE;
 }
 
+static void
+listener_send_activation_replies (GSListener *listener,
+                                  gboolean    activated)
+{
+	GSList *l;
+
+	for (l = listener->priv->activation_replies; l != NULL; l = l->next)
+	{
+		DBusMessage *message = l->data;
+
+		if (activated)
+		{
+			DBusMessage *reply;
+
+			reply = dbus_message_new_method_return (message);
+			if (reply == NULL)
+			{
+				g_error ("No memory");
+			}
+
+			if (! dbus_connection_send (listener->priv->connection, reply, NULL))
+			{
+				g_error ("No memory");
+			}
+
+			dbus_message_unref (reply);
+		}
+		else
+		{
+			raise_error (listener->priv->connection, message,
+			             ACTIVATION_FAILED_ERROR,
+			             "Unable to grab the keyboard and mouse");
+		}
+
+		dbus_message_unref (message);
+	}
+
+	g_slist_free (listener->priv->activation_replies);
+	listener->priv->activation_replies = NULL;
+}
+
+/* Answers a method call now, or when the screen is covered if an
+ * activation is under way.
+ */
+static DBusHandlerResult
+listener_reply_after_activation (GSListener     *listener,
+                                 DBusConnection *connection,
+                                 DBusMessage    *message)
+{
+	DBusMessage *reply;
+
+	if (dbus_message_get_no_reply (message))
+	{
+		return DBUS_HANDLER_RESULT_HANDLED;
+	}
+
+	if (listener->priv->activating)
+	{
+		listener->priv->activation_replies =
+		    g_slist_append (listener->priv->activation_replies,
+		                    dbus_message_ref (message));
+		return DBUS_HANDLER_RESULT_HANDLED;
+	}
+
+	reply = dbus_message_new_method_return (message);
+	if (reply == NULL)
+	{
+		g_error ("No memory");
+	}
+
+	if (! dbus_connection_send (connection, reply, NULL))
+	{
+		g_error ("No memory");
+	}
+
+	dbus_message_unref (reply);
+
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
 gboolean
 gs_listener_set_active (GSListener *listener,
                         gboolean    active)
@@ -443,13 +533,27 @@ gs_listener_set_active (GSListener *listener,
 
 	g_return_val_if_fail (GS_IS_LISTENER (listener), FALSE);
 
-	if (listener->priv->active == active)
+	if (active && listener->priv->activating)
+	{
+		gs_debug ("Trying to set active state when already activating");
+		return TRUE;
+	}
+
+	if (listener->priv->active == active && ! listener->priv->activating)
 	{
 		gs_debug ("Trying to set active state when already: %s",
 		          active ? "active" : "inactive");
 		return FALSE;
 	}
 
+	if (active)
+	{
+		gs_timeline_mark (GS_TIMELINE_LISTENER_ACTIVE);
+
+		/* set first, the activation may finish before the signal returns */
+		listener->priv->activating = TRUE;
+	}
+
 	res = FALSE;
 	g_signal_emit (listener, signals [ACTIVE_CHANGED], 0, active, &res);
 	if (! res)
@@ -460,17 +564,62 @@ gs_listener_set_active (GSListener *listener,
 		/* clear the idle state */
 		if (active)
 		{
+			listener->priv->activating = FALSE;
 			listener_set_session_idle_internal (listener, FALSE);
 		}
 
 		return FALSE;
 	}
 
+	if (active)
+	{
+		/* the rest is done by gs_listener_activation_finished */
+		return TRUE;
+	}
+
+	if (listener->priv->activating)
+	{
+		/* cancelled before the screen was covered */
+		listener->priv->activating = FALSE;
+		listener_set_session_idle_internal (listener, FALSE);
+		listener_send_activation_replies (listener, FALSE);
+		return TRUE;
+	}
+
 	listener_set_active_internal (listener, active);
 
 	return TRUE;
 }
 
+/* Called once the activation started by the "active-changed" signal
+ * has covered the screen or given up.
+ */
+void
+gs_listener_activation_finished (GSListener *listener,
+                                 gboolean    activated)
+{
+	g_return_if_fail (GS_IS_LISTENER (listener));
+
+	if (! listener->priv->activating)
+	{
+		return;
+	}
+
+	listener->priv->activating = FALSE;
+
+	if (activated)
+	{
+		listener_set_active_internal (listener, TRUE);
+	}
+	else
+	{
+		gs_debug ("Activation failed");
+		listener_set_session_idle_internal (listener, FALSE);
+	}
+
+	listener_send_activation_replies (listener, activated);
+}
+
 gboolean
 gs_listener_set_session_idle (GSListener *listener,
                               gboolean    idle)
@@ -1162,7 +1311,6 @@ listener_set_property (GSListener     *listener,
 	int             type;
 	gboolean        rc;
 	DBusMessageIter iter;
-	DBusMessage    *reply;
 
 	path = dbus_message_get_path (message);
 
@@ -1190,21 +1338,7 @@ listener_set_property (GSListener     *listener,
 		return DBUS_HANDLER_RESULT_HANDLED;
 	}
 
-	reply = dbus_message_new_method_return (message);
-
-	if (reply == NULL)
-	{
-		g_error ("No memory");
-	}
-
-	if (! dbus_connection_send (connection, reply, NULL))
-	{
-		g_error ("No memory");
-	}
-
-	dbus_message_unref (reply);
-
-	return DBUS_HANDLER_RESULT_HANDLED;
+	return listener_reply_after_activation (listener, connection, message);
 }
 
 static DBusHandlerResult
@@ -1304,6 +1438,80 @@ listener_get_active_time (GSListener     *listener,
 	return DBUS_HANDLER_RESULT_HANDLED;
 }
 
+static DBusHandlerResult
+listener_get_activation_timelines (GSListener     *listener,
+                                   DBusConnection *connection,
+                                   DBusMessage    *message)
+{
+	DBusMessage        *reply;
+	DBusMessageIter     iter;
+	DBusMessageIter     iter_array;
+	char              **timelines;
+	int                 i;
+
+	reply = dbus_message_new_method_return (message);
+	if (reply == NULL)
+	{
+		g_error ("No memory");
+	}
+
+	dbus_message_iter_init_append (reply, &iter);
+	dbus_message_iter_open_container (&iter,
+	                                  DBUS_TYPE_ARRAY,
+	                                  DBUS_TYPE_STRING_AS_STRING,
+	                                  &iter_array);
+
+	timelines = gs_timeline_dump ();
+	for (i = 0; timelines[i] != NULL; i++)
+	{
+		dbus_message_iter_append_basic (&iter_array, DBUS_TYPE_STRING, &timelines[i]);
+	}
+	g_strfreev (timelines);
+
+	dbus_message_iter_close_container (&iter, &iter_array);
+
+	if (! dbus_connection_send (connection, reply, NULL))
+	{
+		g_error ("No memory");
+	}
+
+	dbus_message_unref (reply);
+
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static DBusHandlerResult
+listener_get_profile (GSListener     *listener,
+                      DBusConnection *connection,
+                      DBusMessage    *message)
+{
+	DBusMessage     *reply;
+	DBusMessageIter  iter;
+	char            *profile;
+
+	reply = dbus_message_new_method_return (message);
+	if (reply == NULL)
+	{
+		g_error ("No memory");
+	}
+
+	profile = gs_profile_dump ();
+
+	dbus_message_iter_init_append (reply, &iter);
+	dbus_message_iter_append_basic (&iter, DBUS_TYPE_STRING, &profile);
+
+	g_free (profile);
+
+	if (! dbus_connection_send (connection, reply, NULL))
+	{
+		g_error ("No memory");
+	}
+
+	dbus_message_unref (reply);
+
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
 static DBusHandlerResult
 listener_show_message (GSListener     *listener,
                        DBusConnection *connection,
@@ -1408,6 +1616,12 @@ add_screensaver_interface (GString *xml, const gchar *const interface)
 		                 "    <method name=\"GetActiveTime\">\n"
 		                 "      <arg name=\"seconds\" direction=\"out\" type=\"u\"/>\n"
 		                 "    </method>\n"
+		                 "    <method name=\"GetActivationTimelines\">\n"
+		                 "      <arg name=\"timelines\" direction=\"out\" type=\"as\"/>\n"
+		                 "    </method>\n"
+		                 "    <method name=\"GetProfile\">\n"
+		                 "      <arg name=\"trace\" direction=\"out\" type=\"s\"/>\n"
+		                 "    </method>\n"
 		                 "    <method name=\"SetActive\">\n"
 		                 "      <arg name=\"value\" direction=\"in\" type=\"b\"/>\n"
 		                 "    </method>\n"
@@ -1528,7 +1742,16 @@ listener_dbus_handle_session_message (DBusConnection *connection,
 	if (dbus_message_is_method_call (message, GS_LISTENER_SERVICE, "Lock"))
 	{
 		g_signal_emit (listener, signals [LOCK], 0);
-		return DBUS_HANDLER_RESULT_HANDLED;
+
+		if (! listener->priv->active && ! listener->priv->activating
+		        && ! dbus_message_get_no_reply (message))
+		{
+			raise_error (connection, message, ACTIVATION_FAILED_ERROR,
+			             "Unable to lock the screen");
+			return DBUS_HANDLER_RESULT_HANDLED;
+		}
+
+		return listener_reply_after_activation (listener, connection, message);
 	}
 	if (dbus_message_is_method_call (message, GS_LISTENER_SERVICE, "Unlock"))
 	{
@@ -1579,6 +1802,14 @@ listener_dbus_handle_session_message (DBusConnection *connection,
 	{
 		return listener_get_active_time (listener, connection, message);
 	}
+	if (dbus_message_is_method_call (message, GS_LISTENER_SERVICE, "GetActivationTimelines"))
+	{
+		return listener_get_activation_timelines (listener, connection, message);
+	}
+	if (dbus_message_is_method_call (message, GS_LISTENER_SERVICE, "GetProfile"))
+	{
+		return listener_get_profile (listener, connection, message);
+	}
 	if (dbus_message_is_method_call (message, GS_LISTENER_SERVICE, "ShowMessage"))
 	{
 		return listener_show_message (listener, connection, message);
@@ -2670,6 +2901,9 @@ gs_listener_finalize (GObject *object)
 		g_hash_table_destroy (listener->priv->throttlers);
 	}
 
+	g_slist_free_full (listener->priv->activation_replies,
+	                   (GDestroyNotify) dbus_message_unref);
+
 	g_free (listener->priv->session_id);
 
 	G_OBJECT_CLASS (gs_listener_parent_class)->finalize (object);
@@ -82,6 +82,8 @@ gboolean    gs_listener_acquire                 (GSListener *listener,
         GError    **error);
 gboolean    gs_listener_set_active              (GSListener *listener,
         gboolean    active);
+void        gs_listener_activation_finished     (GSListener *listener,
+        gboolean    activated);
 gboolean    gs_listener_set_session_idle        (GSListener *listener,
         gboolean    idle);
 void        gs_listener_set_activation_enabled  (GSListener *listener,
@@ -60,6 +60,7 @@ struct GSManagerPrivate
 	guint        lock_enabled : 1;
 	guint        logout_enabled : 1;
 	guint        keyboard_enabled : 1;
+	guint        dialog_prewarm : 1;
 	guint        user_switch_enabled : 1;
 	guint        throttled : 1;
 
@@ -70,6 +71,8 @@ struct GSManagerPrivate
 
 	/* State */
 	guint        active : 1;
+	/* waiting for the devices grab, not active yet */
+	guint        activating : 1;
 	guint        lock_active : 1;
 
 	guint        fading : 1;
@@ -91,6 +94,7 @@ enum
 {
     ACTIVATED,
     DEACTIVATED,
+    ACTIVATION_FINISHED,
     AUTH_REQUEST_BEGIN,
     AUTH_REQUEST_END,
     LAST_SIGNAL
@@ -114,6 +118,7 @@ enum
 };
 
 #define FADE_TIMEOUT 250
+#define UNFADE_TIMEOUT 1000
 
 static guint         signals [LAST_SIGNAL] = { 0, };
 
@@ -535,6 +540,24 @@ gs_manager_set_keyboard_enabled (GSManager *manager,
 	}
 }
 
+void
+gs_manager_set_dialog_prewarm (GSManager *manager,
+                               gboolean   prewarm)
+{
+	g_return_if_fail (GS_IS_MANAGER (manager));
+
+	if (manager->priv->dialog_prewarm != prewarm)
+	{
+		GSList *l;
+
+		manager->priv->dialog_prewarm = (prewarm != FALSE);
+		for (l = manager->priv->windows; l; l = l->next)
+		{
+			gs_window_set_dialog_prewarm (l->data, prewarm);
+		}
+	}
+}
+
 void
 gs_manager_set_user_switch_enabled (GSManager *manager,
                                     gboolean   user_switch_enabled)
@@ -931,6 +954,17 @@ gs_manager_class_init (GSManagerClass *klass)
 	                  g_cclosure_marshal_VOID__VOID,
 	                  G_TYPE_NONE,
 	                  0);
+	signals [ACTIVATION_FINISHED] =
+	    g_signal_new ("activation-finished",
+	                  G_TYPE_FROM_CLASS (object_class),
+	                  G_SIGNAL_RUN_LAST,
+	                  G_STRUCT_OFFSET (GSManagerClass, activation_finished),
+	                  NULL,
+	                  NULL,
+	                  g_cclosure_marshal_VOID__BOOLEAN,
+	                  G_TYPE_NONE,
+	                  1,
+	                  G_TYPE_BOOLEAN);
 	signals [AUTH_REQUEST_BEGIN] =
 	    g_signal_new ("auth-request-begin",
 	                  G_TYPE_FROM_CLASS (object_class),
@@ -1222,8 +1256,8 @@ window_grab_broken_cb (GSWindow           *window,
 static gboolean
 unfade_idle (GSManager *manager)
 {
-	gs_debug ("resetting fade");
-	gs_fade_reset (manager->priv->fade);
+	gs_debug ("fading back in");
+	gs_fade_unfade (manager->priv->fade, UNFADE_TIMEOUT);
 	manager->priv->unfade_idle_id = 0;
 	return FALSE;
 }
@@ -1300,17 +1334,54 @@ apply_background_to_window (GSManager *manager,
 	                                  FALSE);
 	gs_window_set_background_surface (window, surface);
 	cairo_surface_destroy (surface);
+
+	gs_timeline_mark (GS_TIMELINE_BACKGROUND_APPLIED);
+}
+
+/* lets the theme split the work with the other monitors */
+static void
+update_job_monitor (GSWindow  *window,
+                    GSJob     *job,
+                    GSManager *manager)
+{
+	GdkDisplay *display;
+	GdkMonitor *monitor;
+	int         n_monitors;
+	int         i;
+
+	display = gs_window_get_display (window);
+	monitor = gs_window_get_monitor (window);
+	n_monitors = gdk_display_get_n_monitors (display);
+	for (i = 0; i < n_monitors; i++)
+	{
+		if (gdk_display_get_monitor (display, i) == monitor)
+		{
+			gs_job_set_monitor (job, i, n_monitors);
+			break;
+		}
+	}
+}
+
+/* the shares change when monitors come and go */
+static void
+manager_update_job_monitors (GSManager *manager)
+{
+	if (manager->priv->jobs != NULL)
+	{
+		g_hash_table_foreach (manager->priv->jobs, (GHFunc) update_job_monitor, manager);
+	}
 }
 
 static void
 manager_show_window (GSManager *manager,
                      GSWindow  *window)
 {
-	GSJob *job;
+	GSJob      *job;
 
 	apply_background_to_window (manager, window);
 
 	job = gs_job_new_for_widget (gs_window_get_drawing_area (window));
+	update_job_monitor (window, job, manager);
 
 	manager_select_theme_for_job (manager, job);
 	manager_add_job_for_window (manager, window, job);
@@ -1554,9 +1625,16 @@ gs_manager_create_window_for_monitor (GSManager  *manager,
 	gs_window_set_keyboard_enabled (window, manager->priv->keyboard_enabled);
 	gs_window_set_keyboard_command (window, manager->priv->keyboard_command);
 	gs_window_set_status_message (window, manager->priv->status_message);
+	gs_window_set_dialog_prewarm (window, manager->priv->dialog_prewarm);
 
 	connect_window_signals (manager, window);
 
+	/* pace fades with the frame clock of the first window */
+	if (manager->priv->windows == NULL)
+	{
+		gs_fade_set_widget (manager->priv->fade, GTK_WIDGET (window));
+	}
+
 	manager->priv->windows = g_slist_append (manager->priv->windows, window);
 
 	if (manager->priv->active && !manager->priv->fading)
@@ -1591,6 +1669,8 @@ on_display_monitor_added (GdkDisplay *display,
 	/* add a new window */
 	gs_manager_create_window_for_monitor (manager, monitor);
 
+	manager_update_job_monitors (manager);
+
 	/* and put unlock dialog up whereever it's supposed to be */
 	gs_manager_request_unlock (manager);
 }
@@ -1631,8 +1711,13 @@ on_display_monitor_removed (GdkDisplay *display,
 		l = next;
 	}
 
+	gs_fade_set_widget (manager->priv->fade,
+	                    manager->priv->windows ? manager->priv->windows->data : NULL);
+
 	gdk_display_flush (display);
 	gdk_x11_ungrab_server ();
+
+	manager_update_job_monitors (manager);
 }
 
 static void
@@ -1651,6 +1736,8 @@ gs_manager_destroy_windows (GSManager *manager)
 
 	display = gdk_display_get_default ();
 
+	gs_fade_set_widget (manager->priv->fade, NULL);
+
 	g_signal_handlers_disconnect_by_func (display,
 	                                      on_display_monitor_removed,
 	                                      manager);
@@ -1691,6 +1778,7 @@ gs_manager_finalize (GObject *object)
 	remove_unfade_idle (manager);
 	remove_timers (manager);
 
+	gs_grab_cancel (manager->priv->grab);
 	gs_grab_release (manager->priv->grab, TRUE);
 
 	manager_stop_jobs (manager);
@@ -1800,36 +1888,36 @@ fade_done_cb (GSFade    *fade,
 	manager->priv->fading = FALSE;
 }
 
-static gboolean
-gs_manager_activate (GSManager *manager)
+static void
+grab_root_done_cb (GSGrab    *grab,
+                   gboolean   grabbed,
+                   GSManager *manager)
 {
-	gboolean    do_fade;
-	gboolean    res;
+	gboolean do_fade;
 
-	g_return_val_if_fail (manager != NULL, FALSE);
-	g_return_val_if_fail (GS_IS_MANAGER (manager), FALSE);
+	manager->priv->activating = FALSE;
 
-	if (manager->priv->active)
+	if (! grabbed)
 	{
-		gs_debug ("Trying to activate manager when already active");
-		return FALSE;
+		gs_debug ("Unable to grab the devices, not activating");
+		manager->priv->lock_active = FALSE;
+		g_signal_emit (manager, signals [ACTIVATION_FINISHED], 0, FALSE);
+		return;
 	}
 
-	res = gs_grab_grab_root (manager->priv->grab, FALSE, FALSE);
-	if (! res)
-	{
-		return FALSE;
-	}
+	gs_timeline_mark (GS_TIMELINE_GRAB_ROOT);
+
+	manager->priv->jobs = g_hash_table_new_full (g_direct_hash,
+	                      g_direct_equal,
+	                      NULL,
+	                      (GDestroyNotify)remove_job);
 
 	if (manager->priv->windows == NULL)
 	{
 		gs_manager_create_windows (GS_MANAGER (manager));
 	}
 
-	manager->priv->jobs = g_hash_table_new_full (g_direct_hash,
-	                      g_direct_equal,
-	                      NULL,
-	                      (GDestroyNotify)remove_job);
+	gs_timeline_mark (GS_TIMELINE_WINDOWS_CREATED);
 
 	manager->priv->active = TRUE;
 
@@ -1854,6 +1942,33 @@ gs_manager_activate (GSManager *manager)
 		show_windows (manager->priv->windows);
 	}
 
+	g_signal_emit (manager, signals [ACTIVATION_FINISHED], 0, TRUE);
+}
+
+/* Only starts the activation, the manager becomes active and emits
+ * "activation-finished" once the devices are grabbed, which may take
+ * a while if another client holds a grab.
+ */
+static gboolean
+gs_manager_activate (GSManager *manager)
+{
+	g_return_val_if_fail (manager != NULL, FALSE);
+	g_return_val_if_fail (GS_IS_MANAGER (manager), FALSE);
+
+	if (manager->priv->active || manager->priv->activating)
+	{
+		gs_debug ("Trying to activate manager when already active");
+		return FALSE;
+	}
+
+	gs_timeline_mark (GS_TIMELINE_MANAGER_ACTIVATE);
+
+	manager->priv->activating = TRUE;
+
+	gs_grab_grab_root_async (manager->priv->grab, FALSE, FALSE,
+	                         (GSGrabDoneFunc)grab_root_done_cb,
+	                         manager);
+
 	return TRUE;
 }
 
@@ -1863,6 +1978,16 @@ gs_manager_deactivate (GSManager *manager)
 	g_return_val_if_fail (manager != NULL, FALSE);
 	g_return_val_if_fail (GS_IS_MANAGER (manager), FALSE);
 
+	if (manager->priv->activating)
+	{
+		/* nothing was shown yet */
+		gs_debug ("Cancelling the activation");
+		gs_grab_cancel (manager->priv->grab);
+		manager->priv->activating = FALSE;
+		manager->priv->lock_active = FALSE;
+		return TRUE;
+	}
+
 	if (! manager->priv->active)
 	{
 		gs_debug ("Trying to deactivate a screensaver that is not active");
@@ -1873,6 +1998,7 @@ gs_manager_deactivate (GSManager *manager)
 	gs_fade_reset (manager->priv->fade);
 	remove_timers (manager);
 
+	gs_grab_cancel (manager->priv->grab);
 	gs_grab_release (manager->priv->grab, TRUE);
 
 	manager_stop_jobs (manager);
@@ -1916,6 +2042,15 @@ gs_manager_get_active (GSManager *manager)
 	return manager->priv->active;
 }
 
+gboolean
+gs_manager_get_activating (GSManager *manager)
+{
+	g_return_val_if_fail (manager != NULL, FALSE);
+	g_return_val_if_fail (GS_IS_MANAGER (manager), FALSE);
+
+	return manager->priv->activating;
+}
+
 gboolean
 gs_manager_request_unlock (GSManager *manager)
 {
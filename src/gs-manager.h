@@ -49,6 +49,7 @@ typedef struct
 
 	void            (* activated)          (GSManager *manager);
 	void            (* deactivated)        (GSManager *manager);
+	void            (* activation_finished) (GSManager *manager, gboolean activated);
 	void            (* auth_request_begin) (GSManager *manager);
 	void            (* auth_request_end)   (GSManager *manager);
 
@@ -61,6 +62,7 @@ GSManager * gs_manager_new                  (void);
 gboolean    gs_manager_set_active           (GSManager  *manager,
         gboolean    active);
 gboolean    gs_manager_get_active           (GSManager  *manager);
+gboolean    gs_manager_get_activating       (GSManager  *manager);
 
 gboolean    gs_manager_cycle                (GSManager  *manager);
 
@@ -70,6 +72,8 @@ void        gs_manager_set_lock_active      (GSManager  *manager,
         gboolean    lock_active);
 void        gs_manager_set_keyboard_enabled (GSManager  *manager,
         gboolean    enabled);
+void        gs_manager_set_dialog_prewarm   (GSManager  *manager,
+        gboolean    prewarm);
 void        gs_manager_set_keyboard_command (GSManager  *manager,
         const char *command);
 void        gs_manager_set_status_message   (GSManager  *manager,
@@ -57,6 +57,7 @@ struct GSMonitorPrivate {
 };
 
 #define FADE_TIMEOUT 10000
+#define UNFADE_TIMEOUT 1000
 
 G_DEFINE_TYPE_WITH_PRIVATE (GSMonitor, gs_monitor, G_TYPE_OBJECT)
 
@@ -77,12 +78,31 @@ static void manager_deactivated_cb(GSManager* manager, GSMonitor* monitor)
 	gs_listener_set_active (monitor->priv->listener, FALSE);
 }
 
+static void manager_activation_finished_cb(GSManager* manager, gboolean activated, GSMonitor* monitor)
+{
+	/* the idle watcher keeps running until the screen is covered */
+	if (activated && gs_watcher_get_enabled(monitor->priv->watcher))
+	{
+		if (! gs_watcher_set_active(monitor->priv->watcher, FALSE))
+		{
+			gs_debug("Unable to stop the idle watcher");
+		}
+	}
+
+	gs_listener_activation_finished(monitor->priv->listener, activated);
+}
+
 static gboolean watcher_idle_cb(GSWatcher* watcher, gboolean is_idle, GSMonitor* monitor)
 {
 	gboolean res;
 
 	gs_debug ("Idle signal detected: %d", is_idle);
 
+	if (is_idle)
+	{
+		gs_timeline_mark (GS_TIMELINE_IDLE_CHANGED);
+	}
+
 	res = gs_listener_set_session_idle(monitor->priv->listener, is_idle);
 
 	return res;
@@ -92,7 +112,8 @@ static gboolean release_grab_timeout(GSMonitor* monitor)
 {
 	gboolean manager_active;
 
-	manager_active = gs_manager_get_active(monitor->priv->manager);
+	manager_active = gs_manager_get_active(monitor->priv->manager)
+	                 || gs_manager_get_activating(monitor->priv->manager);
 
 	if (! manager_active)
 	{
@@ -103,6 +124,18 @@ static gboolean release_grab_timeout(GSMonitor* monitor)
 	return FALSE;
 }
 
+static void grab_offscreen_done_cb(GSGrab* grab, gboolean grabbed, GSMonitor* monitor)
+{
+	if (grabbed)
+	{
+		gs_fade_async(monitor->priv->fade, FADE_TIMEOUT, NULL, NULL);
+	}
+	else
+	{
+		gs_debug("Could not grab the keyboard so not performing idle warning fade-out");
+	}
+}
+
 static gboolean watcher_idle_notice_cb(GSWatcher* watcher, gboolean in_effect, GSMonitor* monitor)
 {
 	gboolean activation_enabled;
@@ -121,15 +154,8 @@ static gboolean watcher_idle_notice_cb(GSWatcher* watcher, gboolean in_effect, G
 	{
 		if (activation_enabled && ! inhibited)
 		{
-			/* start slow fade */
-			if (gs_grab_grab_offscreen(monitor->priv->grab, FALSE, FALSE))
-			{
-				gs_fade_async(monitor->priv->fade, FADE_TIMEOUT, NULL, NULL);
-			}
-			else
-			{
-				gs_debug("Could not grab the keyboard so not performing idle warning fade-out");
-			}
+			/* start slow fade once the keyboard is grabbed */
+			gs_grab_grab_offscreen_async(monitor->priv->grab, FALSE, FALSE, (GSGrabDoneFunc) grab_offscreen_done_cb, monitor);
 
 			handled = TRUE;
 		}
@@ -138,12 +164,14 @@ static gboolean watcher_idle_notice_cb(GSWatcher* watcher, gboolean in_effect, G
 	{
 		gboolean manager_active;
 
-		manager_active = gs_manager_get_active(monitor->priv->manager);
+		manager_active = gs_manager_get_active(monitor->priv->manager)
+		                 || gs_manager_get_activating(monitor->priv->manager);
 		/* cancel the fade unless manager was activated */
 		if (! manager_active)
 		{
 			gs_debug("manager not active, performing fade cancellation");
-			gs_fade_reset(monitor->priv->fade);
+			gs_grab_cancel(monitor->priv->grab);
+			gs_fade_unfade(monitor->priv->fade, UNFADE_TIMEOUT);
 
 			/* don't release the grab immediately to prevent typing passwords into windows */
 			if (monitor->priv->release_grab_id != 0)
@@ -251,7 +279,8 @@ static gboolean listener_active_changed_cb(GSListener* listener, gboolean active
 
 	idle_watch_enabled = gs_watcher_get_enabled(monitor->priv->watcher);
 
-	if (ret && idle_watch_enabled)
+	/* an activation stops the watcher once it has finished */
+	if (ret && idle_watch_enabled && ! active)
 	{
 		res = gs_watcher_set_active(monitor->priv->watcher, !active);
 
@@ -305,6 +334,7 @@ static void _gs_monitor_update_from_prefs(GSMonitor* monitor, GSPrefs* prefs)
 	gs_manager_set_logout_timeout(monitor->priv->manager, monitor->priv->prefs->logout_timeout);
 	gs_manager_set_logout_command(monitor->priv->manager, monitor->priv->prefs->logout_command);
 	gs_manager_set_keyboard_command(monitor->priv->manager, monitor->priv->prefs->keyboard_command);
+	gs_manager_set_dialog_prewarm(monitor->priv->manager, monitor->priv->prefs->dialog_prewarm);
 	gs_manager_set_cycle_timeout(monitor->priv->manager, monitor->priv->prefs->cycle);
 	gs_manager_set_mode(monitor->priv->manager, monitor->priv->prefs->mode);
 	gs_manager_set_themes(monitor->priv->manager, monitor->priv->prefs->themes);
@@ -394,12 +424,14 @@ static void disconnect_manager_signals(GSMonitor* monitor)
 {
 	g_signal_handlers_disconnect_by_func(monitor->priv->manager, manager_activated_cb, monitor);
 	g_signal_handlers_disconnect_by_func(monitor->priv->manager, manager_deactivated_cb, monitor);
+	g_signal_handlers_disconnect_by_func(monitor->priv->manager, manager_activation_finished_cb, monitor);
 }
 
 static void connect_manager_signals(GSMonitor* monitor)
 {
 	g_signal_connect(monitor->priv->manager, "activated", G_CALLBACK(manager_activated_cb), monitor);
 	g_signal_connect(monitor->priv->manager, "deactivated", G_CALLBACK(manager_deactivated_cb), monitor);
+	g_signal_connect(monitor->priv->manager, "activation-finished", G_CALLBACK(manager_activation_finished_cb), monitor);
 }
 
 static void disconnect_prefs_signals(GSMonitor* monitor)
@@ -451,6 +483,8 @@ static void gs_monitor_finalize(GObject* object)
 	disconnect_manager_signals(monitor);
 	disconnect_prefs_signals(monitor);
 
+	gs_grab_cancel(monitor->priv->grab);
+
 	g_object_unref(monitor->priv->fade);
 	g_object_unref(monitor->priv->grab);
 	g_object_unref(monitor->priv->watcher);
@@ -55,6 +55,7 @@ static void gs_prefs_finalize   (GObject      *object);
 #define KEY_KEYBOARD_ENABLED "embedded-keyboard-enabled"
 #define KEY_KEYBOARD_COMMAND "embedded-keyboard-command"
 #define KEY_STATUS_MESSAGE_ENABLED "status-message-enabled"
+#define KEY_DIALOG_PREWARM "lock-dialog-prewarm"
 
 #define _gs_prefs_set_idle_activation_enabled(x,y) ((x)->idle_activation_enabled = ((y) != FALSE))
 #define _gs_prefs_set_lock_enabled(x,y) ((x)->lock_enabled = ((y) != FALSE))
@@ -64,6 +65,7 @@ static void gs_prefs_finalize   (GObject      *object);
 #define _gs_prefs_set_status_message_enabled(x,y) ((x)->status_message_enabled = ((y) != FALSE))
 #define _gs_prefs_set_logout_enabled(x,y) ((x)->logout_enabled = ((y) != FALSE))
 #define _gs_prefs_set_user_switch_enabled(x,y) ((x)->user_switch_enabled = ((y) != FALSE))
+#define _gs_prefs_set_dialog_prewarm(x,y) ((x)->dialog_prewarm = ((y) != FALSE))
 
 struct GSPrefsPrivate
 {
@@ -333,6 +335,9 @@ gs_prefs_load_from_settings (GSPrefs *prefs)
 
 	bvalue = g_settings_get_boolean (prefs->priv->settings, KEY_USER_SWITCH_ENABLED);
 	_gs_prefs_set_user_switch_enabled (prefs, bvalue);
+
+	bvalue = g_settings_get_boolean (prefs->priv->settings, KEY_DIALOG_PREWARM);
+	_gs_prefs_set_dialog_prewarm (prefs, bvalue);
 }
 
 static void
@@ -444,6 +449,14 @@ key_changed_cb (GSettings *settings,
 		enabled = g_settings_get_boolean (settings, key);
 		_gs_prefs_set_status_message_enabled (prefs, enabled);
 
+	}
+	else if (strcmp (key, KEY_DIALOG_PREWARM) == 0)
+	{
+		gboolean enabled;
+
+		enabled = g_settings_get_boolean (settings, key);
+		_gs_prefs_set_dialog_prewarm (prefs, enabled);
+
 	}
 	else if (strcmp (key, KEY_LOGOUT_ENABLED) == 0)
 	{
@@ -515,6 +528,7 @@ gs_prefs_init (GSPrefs *prefs)
 	prefs->lock_disabled           = FALSE;
 	prefs->logout_enabled          = FALSE;
 	prefs->user_switch_enabled     = FALSE;
+	prefs->dialog_prewarm          = FALSE;
 
 	prefs->timeout                 = 600000;
 	prefs->power_timeout           = 60000;
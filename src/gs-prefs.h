@@ -58,6 +58,7 @@ typedef struct
 	guint            user_switch_enabled : 1;       /* Whether to offer the user switch option */
 	guint            keyboard_enabled : 1;  /* Whether to try to embed a keyboard */
 	guint            status_message_enabled : 1; /* show the status message in the lock */
+	guint            dialog_prewarm : 1;    /* keep the unlock dialog running while locked */
 
 	guint            power_timeout;         /* how much idle time before power management */
 	guint            timeout;               /* how much idle time before activation */
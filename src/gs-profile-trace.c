@@ -0,0 +1,150 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "gs-profile-trace.h"
+
+static void
+json_append_string (GString    *str,
+                    const char *s)
+{
+	g_string_append_c (str, '"');
+
+	for (; s != NULL && *s != '\0'; s++)
+	{
+		if (*s == '"' || *s == '\\')
+		{
+			g_string_append_c (str, '\\');
+			g_string_append_c (str, *s);
+		}
+		else if ((guchar) *s < 0x20)
+		{
+			g_string_append_printf (str, "\\u%04x", (guchar) *s);
+		}
+		else
+		{
+			g_string_append_c (str, *s);
+		}
+	}
+
+	g_string_append_c (str, '"');
+}
+
+/* Starts a trace with the metadata event naming this process */
+GString *
+gs_profile_trace_new (void)
+{
+	GString *str;
+
+	str = g_string_new ("[\n{\"name\":\"process_name\",\"ph\":\"M\"");
+	g_string_append_printf (str, ",\"pid\":%d,\"args\":{\"name\":", (int) getpid ());
+	json_append_string (str, g_get_prgname ());
+	g_string_append (str, "}}");
+
+	return str;
+}
+
+void
+gs_profile_trace_append (GString    *str,
+                         guint       tid,
+                         gint64      time,
+                         const char *func,
+                         const char *note,
+                         const char *label,
+                         gint64      value)
+{
+	const char *phase;
+
+	if (g_strcmp0 (note, "start") == 0)
+	{
+		phase = "B";
+	}
+	else if (g_strcmp0 (note, "end") == 0)
+	{
+		phase = "E";
+	}
+	else if (g_strcmp0 (note, "value") == 0)
+	{
+		phase = "C";
+	}
+	else
+	{
+		phase = "i";
+	}
+
+	g_string_append (str, ",\n{\"name\":");
+	/* begin and end events pair up by nesting within a thread, the
+	 * name is only what the slice is shown as; use the function when
+	 * the mark has no label of its own
+	 */
+	json_append_string (str, label != NULL ? label : func);
+	g_string_append_printf (str,
+	                        ",\"ph\":\"%s\",\"ts\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":%u",
+	                        phase, time, (int) getpid (), tid);
+
+	if (*phase == 'i')
+	{
+		g_string_append (str, ",\"s\":\"t\"");
+	}
+
+	g_string_append (str, ",\"args\":{");
+	if (*phase == 'C')
+	{
+		g_string_append_printf (str, "\"value\":%" G_GINT64_FORMAT, value);
+	}
+	else
+	{
+		g_string_append (str, "\"func\":");
+		json_append_string (str, func);
+	}
+	g_string_append (str, "}}");
+}
+
+/* Closes the trace and returns its text, freeing @str */
+char *
+gs_profile_trace_finish (GString *str)
+{
+	g_string_append (str, "\n]\n");
+
+	return g_string_free (str, FALSE);
+}
+
+/* Writes @contents to mate-screensaver-profile-<prgname>-<pid>.json in
+ * the temporary directory, returning the file name in @path.
+ */
+gboolean
+gs_profile_trace_write (const char *contents,
+                        char      **path,
+                        GError    **error)
+{
+	char *filename;
+
+	filename = g_strdup_printf ("mate-screensaver-profile-%s-%d.json",
+	                            g_get_prgname (), (int) getpid ());
+	*path = g_build_filename (g_get_tmp_dir (), filename, NULL);
+	g_free (filename);
+
+	return g_file_set_contents (*path, contents, -1, error);
+}
@@ -0,0 +1,47 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: nil; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef __GS_PROFILE_TRACE_H
+#define __GS_PROFILE_TRACE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Writer for the Chrome trace event format, shared by the profiling
+ * rings of the daemon (src/gs-debug.c) and of the savers
+ * (savers/gs-theme-engine.c).
+ */
+GString        *gs_profile_trace_new      (void);
+void            gs_profile_trace_append   (GString    *str,
+                                           guint       tid,
+                                           gint64      time,
+                                           const char *func,
+                                           const char *note,
+                                           const char *label,
+                                           gint64      value);
+char           *gs_profile_trace_finish   (GString    *str);
+gboolean        gs_profile_trace_write    (const char *contents,
+                                           char      **path,
+                                           GError    **error);
+
+G_END_DECLS
+
+#endif /* __GS_PROFILE_TRACE_H */
@@ -45,6 +45,7 @@
 static void gs_window_finalize   (GObject       *object);
 
 static gboolean popup_dialog_idle (gpointer data);
+static void maybe_prewarm_dialog (GSWindow *window);
 static void gs_window_dialog_finish (GSWindow *window);
 static void remove_command_watches (GSWindow *window);
 
@@ -71,6 +72,16 @@ struct GSWindowPrivate
 	guint      logout_enabled : 1;
 	guint      keyboard_enabled : 1;
 
+	/* keep a hidden dialog running between unlock requests */
+	guint      dialog_prewarm : 1;
+	/* the dialog is loaded but waits for the next request before
+	 * it shows itself and starts the authentication */
+	guint      dialog_parked : 1;
+	/* the dialog can be revealed with SIGUSR2 */
+	guint      dialog_ready : 1;
+	/* whether the running dialog offers to logout */
+	guint      dialog_logout : 1;
+
 	guint64    logout_timeout;
 	char      *logout_command;
 	char      *keyboard_command;
@@ -851,6 +862,8 @@ gs_window_real_show (GtkWidget *widget)
 	select_popup_events ();
 	window_select_shape_events (window);
 	gdk_window_add_filter (NULL, (GdkFilterFunc)xevent_filter, window);
+
+	maybe_prewarm_dialog (window);
 }
 
 static void
@@ -1465,6 +1478,9 @@ gs_window_dialog_finish (GSWindow *window)
 		window->priv->lock_pid = 0;
 	}
 
+	window->priv->dialog_parked = FALSE;
+	window->priv->dialog_ready = FALSE;
+
 	/* remove events for the case were we failed to show socket */
 	remove_key_events (window);
 }
@@ -1563,12 +1579,29 @@ popdown_dialog (GSWindow *window)
 	remove_command_watches (window);
 }
 
+static void
+reveal_dialog (GSWindow *window)
+{
+	gs_debug ("Revealing the prewarmed dialog");
+
+	window->priv->dialog_parked = FALSE;
+	window->priv->dialog_quit_requested = FALSE;
+	window->priv->dialog_shake_in_progress = FALSE;
+
+	/* otherwise this is done once the dialog says it is ready */
+	if (window->priv->dialog_ready)
+	{
+		kill (window->priv->lock_pid, SIGUSR2);
+	}
+}
+
 static gboolean
 lock_command_watch (GIOChannel   *source,
                     GIOCondition  condition,
                     GSWindow     *window)
 {
 	gboolean finished = FALSE;
+	gboolean prewarm_again = FALSE;
 
 	g_return_val_if_fail (GS_IS_WINDOW (window), FALSE);
 
@@ -1595,6 +1628,14 @@ lock_command_watch (GIOChannel   *source,
 					create_lock_socket (window, id);
 				}
 			}
+			else if (strstr (line, "PREWARMED") != NULL)
+			{
+				window->priv->dialog_ready = TRUE;
+				if (! window->priv->dialog_parked)
+				{
+					reveal_dialog (window);
+				}
+			}
 			else if (strstr (line, "NOTICE=") != NULL)
 			{
 				if (strstr (line, "NOTICE=AUTH FAILED") != NULL)
@@ -1614,6 +1655,14 @@ lock_command_watch (GIOChannel   *source,
 					gs_debug ("Got CANCEL response");
 					window->priv->dialog_response = DIALOG_RESPONSE_CANCEL;
 				}
+
+				/* a cancelled dialog exits, load the next one
+				 * for the following request */
+				if (window->priv->dialog_response == DIALOG_RESPONSE_CANCEL
+				    && window->priv->dialog_prewarm)
+				{
+					prewarm_again = TRUE;
+				}
 				finished = TRUE;
 			}
 			else if (strstr (line, "REQUEST QUIT") != NULL)
@@ -1654,6 +1703,11 @@ lock_command_watch (GIOChannel   *source,
 
 		window->priv->lock_watch_id = 0;
 
+		if (prewarm_again)
+		{
+			maybe_prewarm_dialog (window);
+		}
+
 		return FALSE;
 	}
 
@@ -1691,17 +1745,17 @@ is_user_switch_enabled (GSWindow *window)
 	return window->priv->user_switch_enabled;
 }
 
-static void
-popup_dialog (GSWindow *window)
+static gboolean
+spawn_dialog (GSWindow *window,
+              gboolean  prewarm)
 {
 	gboolean  result;
 	GString  *command;
 
-	gs_debug ("Popping up dialog");
-
 	command = g_string_new (MATE_SCREENSAVER_DIALOG_PATH);
 
-	if (is_logout_enabled (window))
+	window->priv->dialog_logout = is_logout_enabled (window);
+	if (window->priv->dialog_logout)
 	{
 		command = g_string_append (command, " --enable-logout");
 		g_string_append_printf (command, " --logout-command='%s'", window->priv->logout_command);
@@ -1726,13 +1780,14 @@ popup_dialog (GSWindow *window)
 		command = g_string_append (command, " --verbose");
 	}
 
-	gtk_widget_hide (window->priv->drawing_area);
-
-	gtk_widget_queue_draw (GTK_WIDGET (window));
-	set_invisible_cursor (gtk_widget_get_window (GTK_WIDGET (window)), FALSE);
+	if (prewarm)
+	{
+		command = g_string_append (command, " --prewarm");
+	}
 
 	window->priv->dialog_quit_requested = FALSE;
 	window->priv->dialog_shake_in_progress = FALSE;
+	window->priv->dialog_ready = FALSE;
 
 	result = spawn_on_window (window,
 	                          command->str,
@@ -1746,6 +1801,82 @@ popup_dialog (GSWindow *window)
 	}
 
 	g_string_free (command, TRUE);
+
+	return result;
+}
+
+/* Starts the dialog ahead of the next unlock request so that it has
+ * already loaded its widgets when the user starts typing.  The
+ * authentication only starts once it is revealed.
+ */
+static void
+maybe_prewarm_dialog (GSWindow *window)
+{
+	if (! window->priv->dialog_prewarm
+	        || ! window->priv->lock_enabled
+	        || ! gtk_widget_get_visible (GTK_WIDGET (window))
+	        || window->priv->lock_watch_id > 0
+	        || window->priv->popup_dialog_idle_id != 0)
+	{
+		return;
+	}
+
+	gs_debug ("Prewarming dialog");
+
+	if (spawn_dialog (window, TRUE))
+	{
+		window->priv->dialog_parked = TRUE;
+	}
+}
+
+static void
+discard_parked_dialog (GSWindow *window)
+{
+	if (! window->priv->dialog_parked)
+	{
+		return;
+	}
+
+	gs_debug ("Discarding the prewarmed dialog");
+	popdown_dialog (window);
+}
+
+/* the dialog options are fixed once it runs */
+static void
+dialog_options_changed (GSWindow *window)
+{
+	if (window->priv->dialog_parked)
+	{
+		discard_parked_dialog (window);
+		maybe_prewarm_dialog (window);
+	}
+}
+
+static void
+popup_dialog (GSWindow *window)
+{
+	gs_debug ("Popping up dialog");
+
+	/* the logout button appears after a while */
+	if (window->priv->dialog_parked
+	        && window->priv->dialog_logout != is_logout_enabled (window))
+	{
+		discard_parked_dialog (window);
+	}
+
+	gtk_widget_hide (window->priv->drawing_area);
+
+	gtk_widget_queue_draw (GTK_WIDGET (window));
+	set_invisible_cursor (gtk_widget_get_window (GTK_WIDGET (window)), FALSE);
+
+	if (window->priv->dialog_parked)
+	{
+		reveal_dialog (window);
+		return;
+	}
+
+	window->priv->dialog_parked = FALSE;
+	spawn_dialog (window, window->priv->dialog_prewarm);
 }
 
 static gboolean
@@ -1771,7 +1902,7 @@ gs_window_request_unlock (GSWindow *window)
 		return;
 	}
 
-	if (window->priv->lock_watch_id > 0)
+	if (window->priv->lock_watch_id > 0 && ! window->priv->dialog_parked)
 	{
 		return;
 	}
@@ -1816,6 +1947,33 @@ gs_window_set_lock_enabled (GSWindow *window,
 
 	window->priv->lock_enabled = (lock_enabled != FALSE);
 	g_object_notify (G_OBJECT (window), "lock-enabled");
+
+	if (lock_enabled)
+	{
+		maybe_prewarm_dialog (window);
+	}
+	else
+	{
+		discard_parked_dialog (window);
+	}
+}
+
+void
+gs_window_set_dialog_prewarm (GSWindow *window,
+                              gboolean  prewarm)
+{
+	g_return_if_fail (GS_IS_WINDOW (window));
+
+	window->priv->dialog_prewarm = (prewarm != FALSE);
+
+	if (prewarm)
+	{
+		maybe_prewarm_dialog (window);
+	}
+	else
+	{
+		discard_parked_dialog (window);
+	}
 }
 
 GdkDisplay *
@@ -1860,6 +2018,7 @@ gs_window_set_logout_enabled (GSWindow *window,
 	g_return_if_fail (GS_IS_WINDOW (window));
 
 	window->priv->logout_enabled = (logout_enabled != FALSE);
+	dialog_options_changed (window);
 }
 
 void
@@ -1869,6 +2028,7 @@ gs_window_set_user_switch_enabled (GSWindow *window,
 	g_return_if_fail (GS_IS_WINDOW (window));
 
 	window->priv->user_switch_enabled = (user_switch_enabled != FALSE);
+	dialog_options_changed (window);
 }
 
 void
@@ -1903,6 +2063,8 @@ gs_window_set_logout_command (GSWindow   *window,
 	{
 		window->priv->logout_command = NULL;
 	}
+
+	dialog_options_changed (window);
 }
 
 void
@@ -1913,6 +2075,8 @@ gs_window_set_status_message (GSWindow   *window,
 
 	g_free (window->priv->status_message);
 	window->priv->status_message = g_strdup (status_message);
+
+	dialog_options_changed (window);
 }
 
 void
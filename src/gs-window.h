@@ -74,6 +74,8 @@ void        gs_window_set_logout_enabled (GSWindow  *window,
         gboolean   logout_enabled);
 void        gs_window_set_keyboard_enabled (GSWindow  *window,
         gboolean   enabled);
+void        gs_window_set_dialog_prewarm (GSWindow  *window,
+        gboolean   prewarm);
 void        gs_window_set_keyboard_command (GSWindow   *window,
         const char *command);
 void        gs_window_set_user_switch_enabled (GSWindow  *window,
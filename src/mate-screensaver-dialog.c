@@ -33,6 +33,7 @@
 #include <signal.h>
 
 #include <glib/gi18n.h>
+#include <glib-unix.h>
 #include <gdk/gdkx.h>
 #include <gtk/gtk.h>
 #include <gtk/gtkx.h>
@@ -53,6 +54,7 @@ static gboolean enable_switch = FALSE;
 static char* logout_command = NULL;
 static char* status_message = NULL;
 static char* away_message = NULL;
+static gboolean prewarm = FALSE;
 
 static GOptionEntry entries[] = {
 	{"verbose", 0, 0, G_OPTION_ARG_NONE, &verbose, N_("Show debugging output"), NULL},
@@ -62,6 +64,7 @@ static GOptionEntry entries[] = {
 	{"enable-switch", 0, 0, G_OPTION_ARG_NONE, &enable_switch, N_("Show the switch user button"), NULL},
 	{"status-message", 0, 0, G_OPTION_ARG_STRING, &status_message, N_("Message to show in the dialog"), N_("MESSAGE")},
 	{"away-message", 0, 0, G_OPTION_ARG_STRING, &away_message, N_("Not used"), N_("MESSAGE")},
+	{"prewarm", 0, 0, G_OPTION_ARG_NONE, &prewarm, N_("Load the dialog but wait for SIGUSR2 before authenticating"), NULL},
 	{NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL}
 };
 
@@ -375,6 +378,18 @@ static gboolean auth_check_idle(gpointer data)
 	return again;
 }
 
+/* Only start PAM once asked to show, so that a prewarmed dialog does not
+ * hold a transaction open, or a device for modules such as pam_fprintd,
+ * while the screen stays locked.
+ */
+static gboolean reveal_cb(gpointer data)
+{
+	gs_debug("Asked to show the dialog");
+	g_idle_add(auth_check_idle, data);
+
+	return G_SOURCE_REMOVE;
+}
+
 static void show_cb(GtkWidget* widget, gpointer data)
 {
 	print_id(widget);
@@ -414,7 +429,17 @@ static gboolean popup_dialog_idle(gpointer data)
 
 	gtk_widget_realize(widget);
 
-	g_idle_add(auth_check_idle, widget);
+	if (prewarm)
+	{
+		g_unix_signal_add(SIGUSR2, reveal_cb, widget);
+
+		printf("PREWARMED\n");
+		fflush(stdout);
+	}
+	else
+	{
+		g_idle_add(auth_check_idle, widget);
+	}
 
 	gs_profile_end(NULL);
 
@@ -45,6 +45,17 @@
 
 #define XF86_VIDMODE_NAME "XFree86-VidModeExtension"
 
+static gboolean benchmark = FALSE;
+
+static GOptionEntry entries [] =
+{
+	{
+		"benchmark", 0, 0, G_OPTION_ARG_NONE, &benchmark,
+		"Report the fade steps per second of each backend", NULL
+	},
+	{ NULL }
+};
+
 static void
 test_fade (void)
 {
@@ -74,6 +85,44 @@ test_fade (void)
 	g_object_unref (fade);
 }
 
+static void
+benchmark_fade (void)
+{
+	const char *backends [] = { "xrandr", "gamma", "overlay", NULL };
+	GSFade     *fade;
+	int         i;
+
+	fade = gs_fade_new ();
+
+	for (i = 0; backends [i] != NULL; i++)
+	{
+		gint64 start;
+		gint64 elapsed;
+		guint  n_steps;
+
+		if (! gs_fade_set_backend (fade, backends [i]))
+		{
+			g_print ("%-8s unavailable\n", backends [i]);
+			continue;
+		}
+
+		start = g_get_monotonic_time ();
+		gs_fade_sync (fade, 1000);
+		elapsed = g_get_monotonic_time () - start;
+		n_steps = gs_fade_get_n_steps (fade);
+
+		gs_fade_reset (fade);
+
+		g_print ("%-8s %u steps in %.3f s, %.1f steps/sec\n",
+		         backends [i],
+		         n_steps,
+		         (double) elapsed / G_USEC_PER_SEC,
+		         (double) n_steps * G_USEC_PER_SEC / MAX (elapsed, 1));
+	}
+
+	g_object_unref (fade);
+}
+
 int
 main (int    argc,
       char **argv)
@@ -95,7 +144,7 @@ main (int    argc,
 		exit (1);
 	}
 
-	if (! gtk_init_with_args (&argc, &argv, NULL, NULL, NULL, &error))
+	if (! gtk_init_with_args (&argc, &argv, NULL, entries, NULL, &error))
 	{
 		fprintf (stderr, "%s", error->message);
 		g_error_free (error);
@@ -127,7 +176,14 @@ main (int    argc,
 
 	gs_debug_init (TRUE, FALSE);
 
-	test_fade ();
+	if (benchmark)
+	{
+		benchmark_fade ();
+	}
+	else
+	{
+		test_fade ();
+	}
 
 	gs_debug_shutdown ();
 